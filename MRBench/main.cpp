@@ -0,0 +1,1816 @@
+// Microbenchmark of the scene kernels of MRDemo.
+// Runs without camera on a recorded (.bag) or a synthetic pointcloud:
+//   MRBench [recording.bag|-] [iterations] [--scenes] [--no-gl] [--json results.json] [--baseline baseline.json [--threshold percent]]
+//   --scenes     only the scenes in all states of their animations, at the densities of MRDemo
+//   --no-gl      skips the benchmarks that need an OpenGL context, without it they fail if there is none
+//   --json       writes the results (ns/point and Mpoints/s per kernel)
+//   --baseline   compares them with the results of an earlier run, fails if one is slower by more than
+//                the threshold (default 15%) or if a result is missing in either
+// The texture upload, the deprojection on the GPU and the rendering need an OpenGL context (a hidden window).
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>			// before the OpenGL headers
+#endif
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+#include <librealsense2/rsutil.h>
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <cstdio>
+#include <cmath>
+#include <thread>
+#include <map>
+#include <cstdlib>
+#include <omp.h>
+
+#include "../MRDemo/MRScene.h"
+#include "../MRDemo/GlExtensions.h"
+#include "../MRDemo/GlDepthCloud.h"
+#include "../MRDemo/GlTexture.h"
+#include "../MRDemo/GlSnapshotStore.h"
+#include "../MRDemo/GlFramebuffer.h"
+#include "../MRDemo/GlTimerQueries.h"
+#include "../MRDemo/MRDeprojector.h"
+#include "../MRDemo/MRSnapshotFile.h"
+#include "../MRDemo/MRSyntheticDevice.h"
+#include "../MRDemo/MRStageTimings.h"
+#include "../MRDemo/MRLatency.h"
+#include "../MRDemo/MRProfiler.h"
+
+
+struct BenchCloud
+{
+	std::vector<rs2::vertex> vertices;
+	std::vector<rs2::texture_coordinate> tex_coords;
+
+	// raw depth, color and camera model the points are deprojected from
+	std::vector<uint16_t> depth;
+	std::vector<uint8_t> color;		// RGB8
+	float depthScale = 0.001f;
+	rs2_intrinsics depthIntrinsics = {};
+	rs2_intrinsics colorIntrinsics = {};
+	rs2_extrinsics depthToColor = {};
+
+	// frames of a recording, to measure rs2::pointcloud itself
+	rs2::frame depthFrame;
+	rs2::frame colorFrame;
+};
+
+// rs2::pointcloud calculate() and map_to() on the CPU, with the functions of rsutil.h
+static void deprojectCPU(const BenchCloud& cloud, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords)
+{
+	const rs2_intrinsics& di = cloud.depthIntrinsics;
+	const rs2_intrinsics& ci = cloud.colorIntrinsics;
+	for (int y = 0, i = 0; y < di.height; y++)
+	{
+		for (int x = 0; x < di.width; x++, i++)
+		{
+			const float pixel[2] = { (float)x, (float)y };
+			float point[3], colorPoint[3], colorPixel[2];
+			rs2_deproject_pixel_to_point(point, &di, pixel, cloud.depth[i] * cloud.depthScale);
+			vertices[i] = { point[0], point[1], point[2] };
+			if (point[2] == 0.f) {
+				tex_coords[i] = { 0.f, 0.f };
+				continue;
+			}
+			rs2_transform_point_to_point(colorPoint, &cloud.depthToColor, point);
+			rs2_project_point_to_pixel(colorPixel, &ci, colorPoint);
+			tex_coords[i] = { colorPixel[0] / ci.width, colorPixel[1] / ci.height };
+		}
+	}
+}
+
+static void loadBag(const char* filename, BenchCloud& cloud)
+{
+	rs2::config cfg;
+	cfg.enable_device_from_file(filename);
+	rs2::pipeline pipe;
+	rs2::pipeline_profile profile = pipe.start(cfg);
+
+	rs2::frameset frames = pipe.wait_for_frames();
+	rs2::pointcloud pc;
+	rs2::depth_frame depth = frames.get_depth_frame();
+	rs2::video_frame color = frames.get_color_frame();
+	if (color)
+		pc.map_to(color);
+	rs2::points points = pc.calculate(depth);
+
+	cloud.vertices.assign(points.get_vertices(), points.get_vertices() + points.size());
+	cloud.tex_coords.assign(points.get_texture_coordinates(), points.get_texture_coordinates() + points.size());
+
+	const uint16_t* data = reinterpret_cast<const uint16_t*>(depth.get_data());
+	cloud.depth.assign(data, data + depth.get_width() * depth.get_height());
+	for (auto&& sensor : profile.get_device().query_sensors()) {
+		if (auto depthSensor = sensor.as<rs2::depth_sensor>())
+			cloud.depthScale = depthSensor.get_depth_scale();
+	}
+	cloud.depthIntrinsics = depth.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+	if (color) {
+		cloud.colorIntrinsics = color.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+		cloud.depthToColor = depth.get_profile().get_extrinsics_to(color.get_profile());
+	}
+	else {
+		cloud.colorIntrinsics = cloud.depthIntrinsics;
+		cloud.depthToColor = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0 } };
+	}
+	cloud.color.resize(3 * cloud.colorIntrinsics.width * cloud.colorIntrinsics.height, 128);
+	if (color && color.get_profile().format() == RS2_FORMAT_RGB8)
+		memcpy(cloud.color.data(), color.get_data(), cloud.color.size());
+	cloud.depthFrame = depth;
+	cloud.colorFrame = color;
+	pipe.stop();
+}
+
+// person-sized blob at ~0.8m in front of a wall at 2.5m, with some pixels lacking depth
+static void makeSynthetic(int width, int height, BenchCloud& cloud)
+{
+	cloud.depthScale = 0.001f;
+	cloud.depthIntrinsics = { width, height, width / 2.f, height / 2.f, 600.f, 600.f, RS2_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+	cloud.colorIntrinsics = cloud.depthIntrinsics;
+	cloud.depthToColor = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0 } };
+
+	cloud.depth.resize(width * height);
+	cloud.color.resize(3 * width * height);
+	unsigned int seed = 4711;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			seed = seed * 1664525u + 1013904223u;	// deterministic LCG noise
+			float dx = (x - width / 2.f) / (width / 6.f);
+			float dy = (y - height / 2.f) / (height / 2.f);
+			float z = (dx * dx + dy * dy < 1.f) ? 0.8f : 2.5f;
+			z += (float)((seed >> 8) & 0xFF) / 25600.f;
+			if ((seed >> 24) < 16)
+				z = 0.f;	// no depth data
+
+			int i = y * width + x;
+			cloud.depth[i] = (uint16_t)(z / cloud.depthScale + 0.5f);
+			cloud.color[3 * i + 0] = (uint8_t)(255 * x / width);
+			cloud.color[3 * i + 1] = (uint8_t)(255 * y / height);
+			cloud.color[3 * i + 2] = ((x / 16 + y / 16) & 1) ? 255 : 0;
+		}
+	}
+
+	cloud.vertices.resize(width * height);
+	cloud.tex_coords.resize(width * height);
+	deprojectCPU(cloud, cloud.vertices.data(), cloud.tex_coords.data());
+}
+
+// the cloud at another density of MRDemo (decimation magnitude): every density-th pixel in both directions,
+// as the decimation filter without its median, deprojected with the scaled intrinsics
+static void decimateCloud(const BenchCloud& cloud, int density, BenchCloud& decimated)
+{
+	const rs2_intrinsics& di = cloud.depthIntrinsics;
+	decimated.depthScale = cloud.depthScale;
+	decimated.depthIntrinsics = { di.width / density, di.height / density, di.ppx / density, di.ppy / density,
+		di.fx / density, di.fy / density, di.model, { di.coeffs[0], di.coeffs[1], di.coeffs[2], di.coeffs[3], di.coeffs[4] } };
+	decimated.colorIntrinsics = cloud.colorIntrinsics;
+	decimated.depthToColor = cloud.depthToColor;
+	decimated.color = cloud.color;
+
+	const int width = decimated.depthIntrinsics.width, height = decimated.depthIntrinsics.height;
+	decimated.depth.resize((size_t)width * height);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			decimated.depth[(size_t)y * width + x] = cloud.depth[(size_t)y * density * di.width + x * density];
+	decimated.vertices.resize((size_t)width * height);
+	decimated.tex_coords.resize((size_t)width * height);
+	deprojectCPU(decimated, decimated.vertices.data(), decimated.tex_coords.data());
+}
+
+// the former per-point contract: one virtual call per point
+class PerPointScene
+{
+public:
+	virtual ~PerPointScene() {}
+	virtual int renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord, GlPointBuffer& out)
+	{
+		out.add(vertex, tex_coord);
+		return 1;
+	}
+};
+
+static PerPointScene* volatile perPointScene = nullptr;	// volatile: keep the compiler from devirtualizing
+
+// gives the benchmark control over the animation of a scene, on a fixed clock
+template<class Scene>
+class BenchScene : public Scene
+{
+	static const long CLOCK_MILLIS = 1000000;
+
+protected:
+	long currentMillis() const override { return CLOCK_MILLIS; }
+
+public:
+	BenchScene(MRSettings& settings) : Scene(settings) {}
+
+	void animate(int state, long ageMillis)
+	{
+		this->state = state;
+		this->animStartMillis = CLOCK_MILLIS - ageMillis;
+		this->preRenderPointCloud();
+	}
+
+	void draw() { this->pointBuffer.draw(this->settings.use_vbo); }
+	long ageMillis() const { return this->animAgeMillis; }
+	const std::vector<rs2::vertex>& points() const { return this->pointBuffer.points(); }
+};
+
+// the results of measure(), for the JSON report and the comparison with a baseline
+struct BenchResult
+{
+	std::string name;
+	size_t points;
+	double nsPerPoint;
+};
+static std::vector<BenchResult> benchResults;
+
+
+template<typename F>
+static void measure(const std::string& name, size_t pointCount, int iterations, F kernel)
+{
+	kernel();	// warm-up, grows the buffers
+	// the median of the iterations, so a preemption of the benchmark does not count as a regression
+	std::vector<double> ns(std::max(iterations, 1));
+	for (double& iteration : ns) {
+		auto start = std::chrono::steady_clock::now();
+		kernel();
+		iteration = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+	std::nth_element(ns.begin(), ns.begin() + ns.size() / 2, ns.end());
+
+	double nsPerPoint = ns[ns.size() / 2] / pointCount;
+	benchResults.push_back({ name, pointCount, nsPerPoint });
+	std::cout << std::left << std::setw(32) << name << std::right << std::fixed
+		<< std::setw(10) << std::setprecision(2) << (1000.0 / nsPerPoint) << " Mpoints/s"
+		<< std::setw(10) << std::setprecision(3) << nsPerPoint << " ns/point" << std::endl;
+}
+
+// a result this machine cannot measure (e.g. a SIMD level of another CPU), reported with 0 ns/point,
+// so the comparison with a baseline of another machine knows it instead of missing it
+static void skip(const std::string& name, const char* reason)
+{
+	benchResults.push_back({ name, 0, 0.0 });
+	std::cout << std::left << std::setw(32) << name << std::right << " skipped, " << reason << std::endl;
+}
+
+// the thread counts of the parallel kernels, the same on every machine so the results of a baseline match
+static const int BENCH_THREADS[] = { 1, 2, 4, 8 };
+
+// measures kernel(threads) for each of BENCH_THREADS as prefix + threads + suffix; check(threads) first
+// compares the result of the thread count with the sequential one, false ends the benchmark
+template<typename Kernel, typename Check>
+static bool measureThreads(const std::string& prefix, const std::string& suffix, size_t pointCount, int iterations,
+	Kernel kernel, Check check)
+{
+	for (int threads : BENCH_THREADS)
+	{
+		if (!check(threads))
+			return false;
+		measure(prefix + std::to_string(threads) + suffix, pointCount, iterations, [&]() { kernel(threads); });
+	}
+	return true;
+}
+
+template<typename Kernel>
+static void measureThreads(const std::string& prefix, size_t pointCount, int iterations, Kernel kernel)
+{
+	measureThreads(prefix, "", pointCount, iterations, kernel, [](int) { return true; });
+}
+
+// largest difference of the points, 0 if equal to the bit
+static void compareClouds(const BenchCloud& reference, const std::vector<rs2::vertex>& vertices, const std::vector<rs2::texture_coordinate>& tex_coords,
+	float& maxVertexError, float& maxTexError)
+{
+	maxVertexError = maxTexError = 0.f;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		maxVertexError = std::max(maxVertexError, std::abs(vertices[i].x - reference.vertices[i].x));
+		maxVertexError = std::max(maxVertexError, std::abs(vertices[i].y - reference.vertices[i].y));
+		maxVertexError = std::max(maxVertexError, std::abs(vertices[i].z - reference.vertices[i].z));
+		maxTexError = std::max(maxTexError, std::abs(tex_coords[i].u - reference.tex_coords[i].u));
+		maxTexError = std::max(maxTexError, std::abs(tex_coords[i].v - reference.tex_coords[i].v));
+	}
+}
+
+// the effects of IBC and Startrek as they were, with std::rand() per point
+struct RandIceWaterEffect
+{
+	GlPointBuffer& out;
+	float iceY;
+	float iceRandScale;
+
+	void operator()(size_t, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		rs2::vertex realWorldPoint = vertex;
+		rs2::vertex icePoint = vertex;
+		icePoint.y = iceY + std::rand() / iceRandScale;
+		if (icePoint.y <= realWorldPoint.y)
+			realWorldPoint.y = icePoint.y;
+		out.add(realWorldPoint, tex_coord);
+		out.add(icePoint, tex_coord);
+	}
+};
+
+struct RandBeamEffect
+{
+	GlPointBuffer& out;
+	int limit;
+
+	void operator()(size_t, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		if (std::rand() < limit)
+			out.add(vertex, tex_coord);
+	}
+};
+
+// the counter-based random numbers of the effects: reproducible from the seed, the same on every thread,
+// uniform; timed against std::rand(), alone and in the effects
+static int benchRandom(MRSettings& settings, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, int iterations)
+{
+	BenchScene<MRSceneIBC> first(settings), second(settings);
+	GlPointBuffer out;
+	first.animate(2, 1000);
+	second.animate(2, 1000);
+	first.renderBatch(vertices, tex_coords, count, out);
+	std::vector<rs2::vertex> once = out.points();
+	out.clear();
+	second.renderBatch(vertices, tex_coords, count, out);
+	if (once.size() != out.size() || memcmp(once.data(), out.points().data(), once.size() * sizeof(rs2::vertex))) {
+		std::cerr << "ibc gives other points for the same seed and frame" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const PointRandom random(settings.random_seed, 1);
+	std::vector<uint32_t> sequential(count), parallel(count);
+	for (size_t i = 0; i < count; i++)
+		sequential[i] = random.bits(i);
+	#pragma omp parallel for num_threads(4) schedule(dynamic, 1000)
+	for (int i = 0; i < (int)count; i++)
+		parallel[i] = random.bits(i);
+	double sum = 0.0;
+	size_t below = 0;
+	const uint32_t quarter = PointRandom::threshold(0.25f);
+	for (size_t i = 0; i < count; i++) {
+		sum += random.uniform(i);
+		below += random.chance(i, quarter) ? 1 : 0;
+	}
+	std::cout << "random: mean " << std::setprecision(4) << sum / count << ", " << 100.0 * below / count << "% below 0.25" << std::endl;
+	if (parallel != sequential || std::abs(sum / count - 0.5) > 0.005 || std::abs((double)below / count - 0.25) > 0.005) {
+		std::cerr << "the random numbers differ between threads or are not uniform" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<int> rands(count);
+	measure("random/std::rand", count, iterations, [&]() {
+		for (size_t i = 0; i < count; i++)
+			rands[i] = std::rand();
+	});
+	measure("random/counter", count, iterations, [&]() {
+		for (size_t i = 0; i < count; i++)
+			sequential[i] = random.bits(i);
+	});
+	measure("ibc/std::rand/batch", count, iterations, [&]() {
+		out.clear(2 * count);
+		clipAndEmit<false>(vertices, tex_coords, count, {}, RandIceWaterEffect{ out, 0.5f, (RAND_MAX + 1u) / 510.0f });
+	});
+	measure("startrek/beam/std::rand/batch", count, iterations, [&]() {
+		out.clear(count);
+		clipAndEmit<false>(vertices, tex_coords, count, {}, RandBeamEffect{ out, RAND_MAX / 8 });
+	});
+	return EXIT_SUCCESS;
+}
+
+// the laser sweep of Tron as it was: a counter incremented per emitted point gives the rank
+struct CountedLaserEffect
+{
+	GlPointBuffer& out;
+	bool appear;
+	size_t laserPointIndex;
+	size_t currentPointIndex;
+	rs2::vertex& laserPoint;
+
+	void operator()(size_t, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		if (appear ? (currentPointIndex < laserPointIndex) : (currentPointIndex > laserPointIndex))
+			out.add(vertex, tex_coord);
+		else if (currentPointIndex == laserPointIndex)
+			laserPoint = vertex;
+		currentPointIndex++;
+	}
+};
+
+// Tron takes the ranks from the compaction: on the batch the visible points are one range, with clipping they are
+// counted first; both have to emit the points and hit the laser point of the sequential counter
+static int benchTronSweep(MRSettings& settings, BenchCloud& cloud, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, int iterations)
+{
+	GlPointBuffer out, reference;
+	const ScanRange range{ settings.scanMinZ, settings.scanMaxZ };
+	for (int state : { 1, 2 })
+	{
+		for (long ageMillis : { 1L, 2500L, 5000L, 9999L, 10000L, 12000L })
+		{
+			for (bool clip : { false, true })
+			{
+				BenchScene<MRSceneTron> scene(settings);	// without a laser point from before
+				scene.animate(state, ageMillis);
+				reference.clear();
+				rs2::vertex referenceLaser{ 0.0f, 0.0f, 0.0f };
+				clipAndEmit<true>(cloud.vertices.data(), cloud.tex_coords.data(), cloud.vertices.size(), range,
+					CountedLaserEffect{ reference, state == 2, (size_t)((uint64_t)count * scene.ageMillis() / 10000), 0, referenceLaser });
+				out.clear();
+				if (clip)
+					scene.clipAndRenderBatch(cloud.vertices.data(), cloud.tex_coords.data(), cloud.vertices.size(), range, out);
+				else
+					scene.renderBatch(vertices, tex_coords, count, out);
+				const rs2::vertex& laser = scene.laserPoint();
+				if (out.size() != reference.size()
+					|| memcmp(out.points().data(), reference.points().data(), out.size() * sizeof(rs2::vertex))
+					|| memcmp(&laser, &referenceLaser, sizeof(rs2::vertex))) {
+					std::cerr << "tron " << (clip ? "clip" : "batch") << " differs from the sequential sweep, state " << state
+						<< " at " << ageMillis << "ms" << std::endl;
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+
+	BenchScene<MRSceneTron> scene(settings);
+	scene.animate(1, 5000);
+	rs2::vertex laser;
+	measure("tron/disappear/counter/batch", count, iterations, [&]() {
+		out.clear(count);
+		clipAndEmit<false>(vertices, tex_coords, count, {}, CountedLaserEffect{ out, false, count / 2, 0, laser });
+	});
+	measure("tron/disappear/ranks/batch", count, iterations, [&]() {
+		out.clear(count);
+		scene.renderBatch(vertices, tex_coords, count, out);
+	});
+	return EXIT_SUCCESS;
+}
+
+// MRDeprojector (cached rays, SIMD, all cores) compared to rs2::pointcloud (recording) or rsutil.h (synthetic)
+static int benchSimdDeprojection(BenchCloud& cloud, int iterations)
+{
+	const int width = cloud.depthIntrinsics.width;
+	const size_t count = cloud.vertices.size();
+	const int stride = width * sizeof(uint16_t);
+	std::vector<rs2::vertex> vertices(count);
+	std::vector<rs2::texture_coordinate> tex_coords(count);
+	MRDeprojector deprojector;
+	ColorMapping mapping{ cloud.colorIntrinsics, cloud.depthToColor };
+
+	// the kernels do the operations of rsutil.h: the same result on every level, also with distortion
+	BenchCloud distorted;
+	distorted.depth = cloud.depth;
+	distorted.depthScale = cloud.depthScale;
+	distorted.depthIntrinsics = cloud.depthIntrinsics;
+	distorted.depthIntrinsics.model = RS2_DISTORTION_INVERSE_BROWN_CONRADY;
+	const float depthCoeffs[5] = { 0.08f, -0.15f, 0.002f, -0.001f, 0.05f };
+	memcpy(distorted.depthIntrinsics.coeffs, depthCoeffs, sizeof(depthCoeffs));
+	distorted.colorIntrinsics = cloud.colorIntrinsics;
+	distorted.colorIntrinsics.model = RS2_DISTORTION_MODIFIED_BROWN_CONRADY;
+	const float colorCoeffs[5] = { -0.05f, 0.07f, -0.001f, 0.0015f, -0.02f };
+	memcpy(distorted.colorIntrinsics.coeffs, colorCoeffs, sizeof(colorCoeffs));
+	distorted.depthToColor = { { 0.9998f, 0.0175f, 0.f, -0.0175f, 0.9998f, 0.f, 0.f, 0.f, 1.f }, { 0.015f, 0.f, 0.001f } };
+	distorted.vertices.resize(count);
+	distorted.tex_coords.resize(count);
+	deprojectCPU(distorted, distorted.vertices.data(), distorted.tex_coords.data());
+	ColorMapping distortedMapping{ distorted.colorIntrinsics, distorted.depthToColor };
+	for (ESimdLevel level : { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 })
+	{
+		if (level > simdLevel())
+			continue;
+		float vertexError, texError;
+		deprojector.deproject(distorted.depth.data(), stride, distorted.depthIntrinsics, distorted.depthScale, &distortedMapping,
+			vertices.data(), tex_coords.data(), 0, level);
+		compareClouds(distorted, vertices, tex_coords, vertexError, texError);
+		if (vertexError != 0.f || texError != 0.f) {
+			std::cerr << "deprojection " << simdLevelName(level) << " differs from rsutil.h: " << vertexError << " m, " << texError << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// and the result of rs2::pointcloud, which may round differently
+	float vertexError, texError;
+	deprojector.deproject(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, &mapping, vertices.data(), tex_coords.data());
+	compareClouds(cloud, vertices, tex_coords, vertexError, texError);
+	std::cout << "deproject: max. difference to " << (cloud.depthFrame ? "rs2::pointcloud " : "rsutil.h ")
+		<< vertexError * 1000.f << " mm, " << texError << " texture coordinates, " << deprojector.cachedTables() << " ray table(s)" << std::endl;
+	if (vertexError > 1e-5f || texError > 1e-4f) {
+		std::cerr << "deprojection differs from rs2::pointcloud" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (cloud.depthFrame) {
+		rs2::pointcloud pc;
+		measure("deproject/rs2::pointcloud", count, iterations, [&]() {
+			if (cloud.colorFrame)
+				pc.map_to(cloud.colorFrame);
+			rs2::points points = pc.calculate(cloud.depthFrame);
+		});
+	}
+	measure("deproject/rsutil", count, iterations, [&]() {
+		deprojectCPU(cloud, vertices.data(), tex_coords.data());
+	});
+	for (ESimdLevel level : { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 })
+	{
+		const std::string name = "deproject/" + std::string(simdLevelName(level));
+		if (level > simdLevel()) {
+			skip(name, "not supported by the CPU");
+			continue;
+		}
+		measure(name, count, iterations, [&]() {
+			deprojector.deproject(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, &mapping,
+				vertices.data(), tex_coords.data(), 1, level);
+		});
+	}
+	measureThreads("deproject/parallel/", count, iterations, [&](int threads) {
+		deprojector.deproject(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, &mapping,
+			vertices.data(), tex_coords.data(), threads);
+	});
+	return EXIT_SUCCESS;
+}
+
+// the frames of MRSyntheticDevice: the requested share of the pixels within the scan range at every resolution,
+// the same frame for the same frame number; generating them has to keep up with the frame rate
+static int benchSynthetic(MRSettings& settings, int iterations)
+{
+	const int resolutions[][2] = { { 424, 240 }, { 848, 480 }, { 1280, 720 } };
+	for (auto& resolution : resolutions)
+	{
+		for (float inRange : { 0.1f, 0.3f, 0.6f, 0.9f })
+		{
+			MRSyntheticOptions options;
+			options.width = resolution[0];
+			options.height = resolution[1];
+			options.inRange = inRange;
+			options.range = { settings.scanMinZ, settings.scanMaxZ };
+			MRSyntheticScene scene(options);
+			const size_t pixels = (size_t)options.width * options.height;
+			std::vector<uint16_t> depth(pixels), again(pixels);
+			std::vector<uint8_t> rgb(3 * pixels);
+			scene.render(7, depth.data(), rgb.data());
+			scene.render(7, again.data(), rgb.data());
+			size_t within = 0;
+			for (uint16_t d : depth) {
+				float z = d * scene.getDepthUnits();
+				within += (z > options.range.minZ && z <= options.range.maxZ) ? 1 : 0;
+			}
+			const double share = (double)within / pixels;
+			std::cout << "synthetic: " << options.width << "x" << options.height << ", " << std::setprecision(1)
+				<< 100.0 * share << "% within the scan range (" << 100.0 * inRange << "% requested)" << std::endl;
+			if (depth != again || std::abs(share - inRange) > 0.02) {
+				std::cerr << "synthetic frames differ for the same frame number or miss the share within the scan range" << std::endl;
+				return EXIT_FAILURE;
+			}
+			if (inRange == 0.3f)
+				measure("synthetic/" + std::to_string(options.width) + "x" + std::to_string(options.height), pixels, iterations, [&]() {
+					scene.render(7, depth.data(), rgb.data());
+				});
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// the stage timings of MRDemo: percentiles by nearest rank over the last RING_SIZE samples of a stage,
+// and the cost of timing a stage, which MRDemo pays up to ten times per frame and stage thread
+static int benchStageTimings(int iterations)
+{
+	MRStageTimings timings;
+	// 1..2*RING_SIZE ms in a shuffled order, the ring keeps the second half
+	const size_t count = 2 * MRStageTimings::RING_SIZE;
+	for (size_t i = 0; i < count; i++)
+		timings.add(EMRStage::RENDER, (double)((i * 7919) % count + 1));
+	std::vector<double> kept;
+	for (size_t i = MRStageTimings::RING_SIZE; i < count; i++)
+		kept.push_back((double)((i * 7919) % count + 1));
+	std::sort(kept.begin(), kept.end());
+	auto rank = [&](double p) { return kept[(size_t)std::ceil(p * kept.size()) - 1]; };
+	double mean = 0.0;
+	for (double millis : kept)
+		mean += millis / kept.size();
+
+	MRStageTimings::Summary summary = timings.summary(EMRStage::RENDER);
+	std::cout << "stage timings: p50 " << summary.p50 << ", p95 " << summary.p95 << ", p99 " << summary.p99
+		<< " of " << summary.samples << " samples" << std::endl;
+	if (summary.samples != MRStageTimings::RING_SIZE || summary.p50 != rank(0.50) || summary.p95 != rank(0.95)
+		|| summary.p99 != rank(0.99) || summary.max != kept.back() || std::abs(summary.mean - mean) > 1e-6 * mean
+		|| timings.summary(EMRStage::SWAP).samples != 0) {
+		std::cerr << "stage timings differ from the percentiles of the last samples" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const int timers = 1000;
+	measure("stage timer", timers, iterations, [&]() {
+		for (int i = 0; i < timers; i++)
+			MRStageTimer timer(&timings, EMRStage::IMGUI);
+	});
+	measure("stage timer/off", timers, iterations, [&]() {
+		for (int i = 0; i < timers; i++)
+			MRStageTimer timer(nullptr, EMRStage::IMGUI);
+	});
+	measure("stage timings/summary", MRStageTimings::RING_SIZE, iterations, [&]() {
+		summary = timings.summary(EMRStage::IMGUI);
+	});
+	return EXIT_SUCCESS;
+}
+
+// the capture-to-display latency of MRDemo: percentiles by nearest rank over the bins of its histograms, and the
+// frame numbers that were never shown, which do not count the start of the next pass through a recording
+static int benchLatency(int iterations)
+{
+	MRLatency latency;
+	const int frames = 1000;
+	auto displayed = std::chrono::steady_clock::now();
+	MRFrameTag tag;
+	for (int i = 0; i < frames; i++) {
+		// 0.5..99.5 ms after the arrival, each ten times, and 5 ms from the sensor to the arrival; every 10th frame is skipped
+		tag.frameNumber = 1 + i + i / 9;
+		tag.arrival = displayed - std::chrono::microseconds(500 + (i % 100) * 1000);
+		tag.sensorMillis = 5.0;
+		latency.shown(tag, displayed);
+	}
+	tag.frameNumber = 1;
+	tag.arrival = displayed - std::chrono::microseconds(500);
+	latency.shown(tag, displayed);
+
+	MRLatency::Summary arrival = latency.summary(EMRLatency::ARRIVAL);
+	MRLatency::Summary capture = latency.summary(EMRLatency::CAPTURE);
+	std::cout << "latency: " << latency.statusText() << std::endl;
+	unsigned long long skipped = (frames - 1) / 9;
+	if (arrival.frames != frames + 1 || arrival.p50 != 50.0 || arrival.p95 != 95.0 || arrival.p99 != 99.0
+		|| std::abs(arrival.max - 99.5) > 1e-6 || capture.p50 != 55.0 || std::abs(capture.max - 104.5) > 1e-6
+		|| latency.shownFrames() != frames + 1 || latency.skippedFrames() != skipped) {
+		std::cerr << "latency differs from the percentiles of the frames shown" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	measure("latency/shown", frames, iterations, [&]() {
+		for (int i = 0; i < frames; i++) {
+			tag.frameNumber++;
+			latency.shown(tag, displayed);
+		}
+	});
+	measure("latency/summary", MRLatency::BINS, iterations, [&]() {
+		arrival = latency.summary(EMRLatency::ARRIVAL);
+	});
+	return EXIT_SUCCESS;
+}
+
+// the zones of MRProfiler from several threads: each thread keeps its last EVENTS_PER_THREAD events, all of them
+// end up in the trace but the oldest of a full ring (its slot is the next to be written); a zone costs two clock
+// reads and a store, MRDemo records ~20 per frame
+static int benchProfiler(int iterations)
+{
+	MRProfiler& profiler = MRProfiler::instance();
+	profiler.setThreadName("MRBench");
+	const size_t zones = 1000, frames = 10, workers = 3, overflow = 5000;
+	for (size_t f = 0; f < frames; f++) {
+		profiler.frame();
+		for (size_t z = 0; z < zones / frames; z++)
+			MRProfileZone zone("bench");
+	}
+	std::vector<std::thread> threads;
+	for (size_t w = 0; w < workers; w++)
+		threads.emplace_back([&]() {
+			profiler.setThreadName("worker");
+			for (size_t z = 0; z < MRProfiler::EVENTS_PER_THREAD + overflow; z++)
+				MRProfileZone zone("work");
+		});
+	for (std::thread& thread : threads)
+		thread.join();
+
+	const std::string path = "MRBench-trace.json";
+	bool written = profiler.writeChromeTrace(path);
+	std::ifstream file(path);
+	std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	std::remove(path.c_str());
+	auto occurrences = [&](const std::string& text) {
+		size_t count = 0;
+		for (size_t pos = json.find(text); pos != std::string::npos; pos = json.find(text, pos + 1))
+			count++;
+		return count;
+	};
+	const size_t complete = occurrences("\"ph\":\"X\""), instant = occurrences("\"ph\":\"i\""), named = occurrences("\"thread_name\"");
+	std::cout << "profiler: " << complete << " zones, " << instant << " frames of " << named << " threads in the trace ("
+		<< json.size() / 1024 << " KB)" << std::endl;
+	if (!written || complete != zones + workers * (MRProfiler::EVENTS_PER_THREAD - 1) || instant != frames || named != workers + 1
+		|| profiler.eventCount() != complete + instant + workers || json.compare(json.size() - 4, 4, "\n]}\n") != 0) {
+		std::cerr << "the trace misses zones or holds overwritten ones" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const int count = 1000;
+	measure("profiler/zone", count, iterations, [&]() {
+		for (int i = 0; i < count; i++)
+			MRProfileZone zone("bench");
+	});
+	measure("profiler/trace", MRProfiler::EVENTS_PER_THREAD * (workers + 1), 1, [&]() {
+		profiler.writeChromeTrace(path);
+	});
+	std::remove(path.c_str());
+	return EXIT_SUCCESS;
+}
+
+// what renderPointCloud() does with a new cloud, without the draw: every scene in every state of its animation
+// (on the fixed clock of BenchScene) at the densities of MRDemo; the same cloud gives the same points every time
+static int benchScenes(const BenchCloud& cloud, MRSettings& settings, int iterations)
+{
+	BenchScene<MRScene> plain(settings);
+	BenchScene<MRSceneSnapshot> snapshot(settings);
+	BenchScene<MRSceneIBC> ibc(settings);
+	BenchScene<MRSceneTron> tron(settings);
+	BenchScene<MRSceneStartrek> startrek(settings);
+	struct SceneState {
+		const char* name;
+		MRScene* scene;
+		std::function<void()> animate;
+		std::function<const std::vector<rs2::vertex>&()> points;
+	};
+	auto state = [](const char* name, auto& scene, int state, long ageMillis) {
+		return SceneState{ name, &scene, [&scene, state, ageMillis]() { scene.animate(state, ageMillis); },
+			[&scene]() -> const std::vector<rs2::vertex>& { return scene.points(); } };
+	};
+	const SceneState states[] = {
+		state("plain", plain, 0, 0),
+		state("snapshot", snapshot, 0, 0),
+		state("ibc/idle", ibc, 0, 0),
+		state("ibc/water", ibc, 1, 0),
+		state("ibc/splash", ibc, 2, 1000),
+		state("tron/idle", tron, 0, 0),
+		state("tron/disappear", tron, 1, 5000),
+		state("tron/appear", tron, 2, 5000),
+		state("startrek/idle", startrek, 0, 0),
+		state("startrek/beam-down", startrek, 1, 2500),
+		state("startrek/beam-up", startrek, 2, 2500),
+	};
+
+	for (int density : { 1, 2, 4 })
+	{
+		BenchCloud decimated;
+		if (density > 1)
+			decimateCloud(cloud, density, decimated);
+		const BenchCloud& points = density > 1 ? decimated : cloud;
+		const size_t count = points.vertices.size();
+		for (const SceneState& sceneState : states)
+		{
+			sceneState.animate();
+			sceneState.scene->processPointCloud(points.vertices.data(), points.tex_coords.data(), count);
+			std::vector<rs2::vertex> first = sceneState.points();
+			sceneState.scene->processPointCloud(points.vertices.data(), points.tex_coords.data(), count);
+			const std::vector<rs2::vertex>& again = sceneState.points();
+			if (first.size() != again.size() || memcmp(first.data(), again.data(), first.size() * sizeof(rs2::vertex))) {
+				std::cerr << "scene " << sceneState.name << " emits other points for the same cloud and time" << std::endl;
+				return EXIT_FAILURE;
+			}
+			measure("scene/" + std::string(sceneState.name) + "/density" + std::to_string(density), count, iterations, [&]() {
+				sceneState.scene->processPointCloud(points.vertices.data(), points.tex_coords.data(), count);
+			});
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+// the results as JSON, one result per line: {"name": ..., "points": ..., "ns_per_point": ..., "mpoints_per_s": ...}
+static bool writeResults(const std::string& path, const std::string& cloudName, int iterations)
+{
+	std::ofstream file(path);
+	file << "{\n\"cloud\": \"" << cloudName << "\",\n\"simd\": \"" << simdLevelName(simdLevel()) << "\",\n\"iterations\": "
+		<< iterations << ",\n\"results\": [\n" << std::fixed << std::setprecision(4);
+	for (size_t i = 0; i < benchResults.size(); i++) {
+		const BenchResult& result = benchResults[i];
+		file << "{\"name\": \"" << result.name << "\", \"points\": " << result.points << ", \"ns_per_point\": " << result.nsPerPoint
+			<< ", \"mpoints_per_s\": " << (result.nsPerPoint > 0.0 ? 1000.0 / result.nsPerPoint : 0.0) << "}"
+			<< (i + 1 < benchResults.size() ? ",\n" : "\n");
+	}
+	file << "]\n}\n";
+	std::cout << "results written to " << path << std::endl;
+	return (bool)file;
+}
+
+// fails if a result is slower than in the baseline (written by writeResults()) by more than threshold (0.15..15%),
+// or if a result is missing in either: a renamed or dropped kernel must not pass unnoticed; a result skipped on
+// either machine (0 ns/point, see skip()) is not compared
+static int compareBaseline(const std::string& path, double threshold)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cerr << "no baseline " << path << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::map<std::string, double> baseline;
+	std::string line;
+	const std::string nameKey = "\"name\": \"", nsKey = "\"ns_per_point\": ";
+	while (std::getline(file, line)) {
+		size_t name = line.find(nameKey), ns = line.find(nsKey);
+		if (name == std::string::npos || ns == std::string::npos)
+			continue;
+		name += nameKey.size();
+		baseline[line.substr(name, line.find('"', name) - name)] = std::strtod(line.c_str() + ns + nsKey.size(), nullptr);
+	}
+
+	size_t compared = 0, regressed = 0, missing = 0, skipped = 0;
+	for (const BenchResult& result : benchResults) {
+		auto base = baseline.find(result.name);
+		if (base == baseline.end()) {
+			missing++;
+			std::cerr << "not in baseline: " << result.name << std::endl;
+			continue;
+		}
+		const double baseNs = base->second;
+		baseline.erase(base);
+		if (baseNs <= 0.0 || result.nsPerPoint <= 0.0) {
+			skipped++;
+			continue;
+		}
+		compared++;
+		double change = result.nsPerPoint / baseNs - 1.0;
+		if (change > threshold) {
+			regressed++;
+			std::cerr << "regression: " << result.name << " " << std::fixed << std::setprecision(3) << baseNs << " --> "
+				<< result.nsPerPoint << " ns/point (+" << std::setprecision(1) << 100.0 * change << "%)" << std::endl;
+		}
+	}
+	for (auto& base : baseline) {
+		missing++;
+		std::cerr << "not in results: " << base.first << std::endl;
+	}
+	std::cout << "baseline " << path << ": " << compared << " results compared, " << regressed << " slower by more than "
+		<< std::fixed << std::setprecision(0) << 100.0 * threshold << "%, " << missing << " missing in either, " << skipped << " skipped" << std::endl;
+	return (regressed || missing) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// the colors of the snapshots: every level and thread count gives the colors of the scalar kernel, which match
+// a reference in double (bilinear within one step of rounding), for RGB8, RGBA8 and Y8 and at the edges of the image
+static int benchColorSampling(BenchCloud& cloud, int iterations)
+{
+	const int width = cloud.colorIntrinsics.width, height = cloud.colorIntrinsics.height;
+	std::vector<rs2::texture_coordinate> tex_coords = cloud.tex_coords;
+	// beyond the corners, on the last pixel (the gather must not read beyond the image), invalid values
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	for (rs2::texture_coordinate edge : std::vector<rs2::texture_coordinate>{ { 0.f, 0.f }, { 1.f, 1.f }, { 0.9999f, 0.9999f },
+		{ -0.2f, 0.5f }, { 1.3f, 0.5f }, { 0.5f, -3.f }, { 0.5f, 1e9f }, { nan, 0.5f }, { 0.5f, -nan } })
+		tex_coords.insert(tex_coords.begin() + tex_coords.size() / 2, 8, edge);		// 8 in a row, filling a SIMD step
+	for (int i = 0; i < 7; i++)
+		tex_coords.push_back({ 1.f, 1.f });
+	const size_t count = tex_coords.size();
+
+	std::vector<uint8_t> rgba(4 * (size_t)width * height), grey((size_t)width * height);
+	for (size_t i = 0; i < grey.size(); i++) {
+		memcpy(&rgba[4 * i], &cloud.color[3 * i], 3);
+		rgba[4 * i + 3] = 255;
+		grey[i] = cloud.color[3 * i];
+	}
+	struct Format { const char* name; ColorImage image; } formats[] = {
+		{ "rgb8", { cloud.color.data(), width, height, 3 * width, 3 } },
+		{ "rgba8", { rgba.data(), width, height, 4 * width, 4 } },
+		{ "y8", { grey.data(), width, height, width, 1 } },
+	};
+
+	std::vector<uint8_t> reference(3 * count), rgb(3 * count);
+	for (const Format& format : formats)
+	{
+		const ColorImage& image = format.image;
+		auto channel = [&](int x, int y, int c) {
+			x = std::min(std::max(x, 0), width - 1);
+			y = std::min(std::max(y, 0), height - 1);
+			const uint8_t* p = image.data + (size_t)y * image.strideBytes + (size_t)x * image.bytesPerPixel;
+			return (double)p[image.bytesPerPixel < 3 ? 0 : c];
+		};
+		for (ESampling sampling : { SAMPLE_NEAREST, SAMPLE_BILINEAR })
+		{
+			const std::string name = std::string(format.name) + (sampling == SAMPLE_NEAREST ? "/nearest" : "/bilinear");
+			sampleColors(tex_coords.data(), count, image, sampling, reference.data(), 1, SIMD_SCALAR);
+			int maxError = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				// the pixel coordinates in float as the kernels, which decides the pixel at its border
+				float u = tex_coords[i].u, v = tex_coords[i].v;
+				u = (u == u) ? std::min(std::max(u, -1.f), 2.f) : -1.f;	// NaN to the first pixel, as the kernels
+				v = (v == v) ? std::min(std::max(v, -1.f), 2.f) : -1.f;
+				for (int c = 0; c < 3; c++)
+				{
+					double expected;
+					if (sampling == SAMPLE_NEAREST) {
+						expected = channel((int)std::floor(u * width), (int)std::floor(v * height), c);
+					}
+					else {
+						double x = u * width - 0.5f, y = v * height - 0.5f;
+						double x0 = std::floor(x), y0 = std::floor(y), fx = x - x0, fy = y - y0;
+						double top = channel((int)x0, (int)y0, c) * (1 - fx) + channel((int)x0 + 1, (int)y0, c) * fx;
+						double bottom = channel((int)x0, (int)y0 + 1, c) * (1 - fx) + channel((int)x0 + 1, (int)y0 + 1, c) * fx;
+						expected = std::floor(top * (1 - fy) + bottom * fy + 0.5);
+					}
+					maxError = std::max(maxError, std::abs(reference[3 * i + c] - (int)expected));
+				}
+			}
+			if (maxError > (sampling == SAMPLE_NEAREST ? 0 : 1)) {
+				std::cerr << "color sampling " << name << " differs from the reference by " << maxError << std::endl;
+				return EXIT_FAILURE;
+			}
+			for (ESimdLevel level : { SIMD_SSE, SIMD_AVX2 })
+			{
+				for (int threads : { 1, 4 })
+				{
+					if (level > simdLevel())
+						continue;
+					memset(rgb.data(), 0xCD, rgb.size());
+					sampleColors(tex_coords.data(), count, image, sampling, rgb.data(), threads, level);
+					if (rgb != reference) {
+						std::cerr << "color sampling " << name << " " << simdLevelName(level) << " with " << threads << " threads differs from scalar" << std::endl;
+						return EXIT_FAILURE;
+					}
+				}
+			}
+		}
+	}
+
+	// the points of a whole frame, as captured by a snapshot
+	const ColorImage& image = formats[0].image;
+	for (ESampling sampling : { SAMPLE_NEAREST, SAMPLE_BILINEAR })
+	{
+		const std::string name = std::string("color/") + (sampling == SAMPLE_NEAREST ? "nearest/" : "bilinear/");
+		for (ESimdLevel level : { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 })
+		{
+			if (level > simdLevel()) {
+				skip(name + simdLevelName(level), "not supported by the CPU");
+				continue;
+			}
+			measure(name + simdLevelName(level), count, iterations, [&]() {
+				sampleColors(tex_coords.data(), count, image, sampling, rgb.data(), 1, level);
+			});
+		}
+		measureThreads(name + "parallel/", count, iterations, [&](int threads) {
+			sampleColors(tex_coords.data(), count, image, sampling, rgb.data(), threads);
+		});
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		sampleColors(tex_coords.data(), count, image, SAMPLE_BILINEAR, rgb.data());
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+	std::cout << "color: " << count << " points bilinear in " << std::setprecision(2) << ms << " ms, of a frame budget of 33.3 ms" << std::endl;
+	return EXIT_SUCCESS;
+}
+
+// the Z-histogram of the setup scene, from the vertices
+static void histogramOfVertices(const rs2::vertex* vertices, size_t count, int* histogram)
+{
+	memset(histogram, 0, DEPTH_HISTOGRAM_BINS * sizeof(int));
+	for (size_t i = 0; i < count; i++)
+	{
+		int z = (int)(vertices[i].z * 100.f);
+		if (z > 0 && z < DEPTH_HISTOGRAM_BINS)
+			histogram[z]++;
+	}
+}
+
+// setup scene: deprojection of all pixels, the histogram and the clipping in separate passes over the floats,
+// compared to the fused pass over the raw depth which deprojects only the pixels within range
+static int benchFusedScan(BenchCloud& cloud, MRSettings& settings, int iterations)
+{
+	const int width = cloud.depthIntrinsics.width;
+	const int height = cloud.depthIntrinsics.height;
+	const size_t count = cloud.vertices.size();
+	const int stride = width * sizeof(uint16_t);
+	MRDeprojector deprojector;
+	ColorMapping mapping{ cloud.colorIntrinsics, cloud.depthToColor };
+	std::vector<rs2::vertex> vertices(count), clippedVertices(count), fusedVertices(count);
+	std::vector<rs2::texture_coordinate> tex_coords(count), clippedTexCoords(count), fusedTexCoords(count);
+	std::vector<int> histogram(DEPTH_HISTOGRAM_BINS), fusedHistogram(DEPTH_HISTOGRAM_BINS);
+	CompactionScratch scratch;
+
+	// the raw scan range has to select the same points as the float clipping, also at its boundaries
+	deprojector.deproject(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, &mapping, vertices.data(), tex_coords.data());
+	histogramOfVertices(vertices.data(), count, histogram.data());
+	const float z800 = 800 * cloud.depthScale;
+	for (ScanRange range : { ScanRange{ settings.scanMinZ, settings.scanMaxZ }, ScanRange{ 0.f, z800 }, ScanRange{ z800, 2.5f },
+		ScanRange{ -1.f, 100.f }, ScanRange{ 1.f, 0.5f } })
+	{
+		size_t n = compactScanRange(vertices.data(), tex_coords.data(), count, range, clippedVertices.data(), clippedTexCoords.data());
+		for (int threads : { 1, 4 })
+		{
+			size_t fused = deprojector.deprojectClipped(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, range, &mapping,
+				fusedVertices.data(), fusedTexCoords.data(), fusedHistogram.data(), threads);
+			if (fused != n
+				|| memcmp(fusedVertices.data(), clippedVertices.data(), n * sizeof(rs2::vertex))
+				|| memcmp(fusedTexCoords.data(), clippedTexCoords.data(), n * sizeof(rs2::texture_coordinate))
+				|| fusedHistogram != histogram) {
+				std::cerr << "fused scan with " << threads << " threads differs for range " << range.minZ << ".." << range.maxZ
+					<< ": " << fused << " instead of " << n << " points" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	const ScanRange range{ settings.scanMinZ, settings.scanMaxZ };
+	size_t n = compactScanRange(vertices.data(), tex_coords.data(), count, range, clippedVertices.data(), clippedTexCoords.data());
+	std::cout << "setup: " << n << " of " << count << " pixels within range" << std::endl;
+	measure("setup/separate", count, iterations, [&]() {
+		deprojector.deproject(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, &mapping, vertices.data(), tex_coords.data());
+		histogramOfVertices(vertices.data(), count, histogram.data());
+		compactScanRangeParallel(vertices.data(), tex_coords.data(), count, range, clippedVertices.data(), clippedTexCoords.data(), scratch);
+	});
+	measureThreads("setup/fused/", count, iterations, [&](int threads) {
+		deprojector.deprojectClipped(cloud.depth.data(), stride, cloud.depthIntrinsics, cloud.depthScale, range, &mapping,
+			fusedVertices.data(), fusedTexCoords.data(), fusedHistogram.data(), threads);
+	});
+	return EXIT_SUCCESS;
+}
+
+// one upload per frame, as the color stream in MRDemo
+template<typename F>
+static void measureFrames(const std::string& name, size_t bytes, int iterations, F upload)
+{
+	upload();	// warm-up, allocates the storage
+	glFinish();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		upload();
+	double submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+	glFinish();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		upload();
+		glFinish();
+	}
+	double finishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+	std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(10) << submitMs << " ms/frame submitted" << std::setw(10) << finishMs << " ms/frame finished"
+		<< std::setw(10) << std::setprecision(0) << (bytes / finishMs / 1000.0) << " MB/s" << std::endl;
+}
+
+// the texture of GlTexture, read back
+static std::vector<uint8_t> readTexture(GLuint texture, int width, int height)
+{
+	std::vector<uint8_t> image(3 * width * height);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return image;
+}
+
+// GlTexture: storage allocated once and streamed through pixel buffer objects,
+// compared to a new glTexImage2D() per frame (before)
+static int benchTextureUpload(int iterations)
+{
+	struct Format { int width; int height; int stride; rs2_format format; int bytesPerPixel; };
+	for (Format f : { Format{ 1920, 1080, 1920 * 3, RS2_FORMAT_RGB8, 3 }, Format{ 638, 480, 640 * 3, RS2_FORMAT_RGB8, 3 },
+		Format{ 638, 480, 638 * 3 + 2, RS2_FORMAT_RGB8, 3 },
+		Format{ 640, 480, 640 * 4, RS2_FORMAT_RGBA8, 4 }, Format{ 848, 480, 848, RS2_FORMAT_Y8, 1 } })
+	{
+		std::vector<uint8_t> frame((size_t)f.stride * f.height);
+		for (size_t i = 0; i < frame.size(); i++)
+			frame[i] = (uint8_t)(i * 7 + i / 4099);
+		std::vector<uint8_t> expected(3 * f.width * f.height);
+		for (int y = 0; y < f.height; y++) {
+			for (int x = 0; x < f.width; x++) {
+				const uint8_t* p = &frame[(size_t)y * f.stride + x * f.bytesPerPixel];
+				for (int c = 0; c < 3; c++)
+					expected[3 * (y * f.width + x) + c] = (f.bytesPerPixel == 1) ? p[0] : p[c];
+			}
+		}
+		for (bool pbo : { false, true })
+		{
+			GlTexture texture;
+			texture.setPixelBuffers(pbo);
+			texture.upload(frame.data(), f.width, f.height, f.stride, f.format);
+			texture.upload(frame.data(), f.width, f.height, f.stride, f.format);	// into the allocated storage
+			if (readTexture(texture.get_gl_handle(), f.width, f.height) != expected) {
+				std::cerr << "texture upload " << (pbo ? "with" : "without") << " pixel buffers differs for "
+					<< rs2_format_to_string(f.format) << " " << f.width << "x" << f.height << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	std::cout << "texture storage: " << (glext::hasTexStorage() ? "immutable" : "allocated once")
+		<< ", pixel buffers: " << (glext::hasPBO() ? "yes" : "not supported") << std::endl;
+
+	// the color stream at 1080p
+	const int width = 1920, height = 1080;
+	std::vector<uint8_t> frame(3 * width * height, 128);
+	GLuint legacy;
+	glGenTextures(1, &legacy);
+	measureFrames("upload/teximage", frame.size(), iterations, [&]() {
+		glBindTexture(GL_TEXTURE_2D, legacy);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, frame.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	});
+	glDeleteTextures(1, &legacy);
+	GlTexture storage;
+	storage.setPixelBuffers(false);
+	measureFrames("upload/storage", frame.size(), iterations, [&]() {
+		storage.upload(frame.data(), width, height, 3 * width, RS2_FORMAT_RGB8);
+	});
+	GlTexture streamed;
+	streamed.setPixelBuffers(true);
+	measureFrames("upload/storage+pbo", frame.size(), iterations, [&]() {
+		streamed.upload(frame.data(), width, height, 3 * width, RS2_FORMAT_RGB8);
+	});
+	return EXIT_SUCCESS;
+}
+
+
+// renders the points of the plain scene once with the pipeline of MRDemo and reads back the image
+template<typename F>
+static std::vector<uint8_t> renderImage(int width, int height, F drawPoints)
+{
+	glClearColor(0.6f, 0.6f, 0.6f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	drawPoints();
+	std::vector<uint8_t> image(3 * width * height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+	return image;
+}
+
+// deprojection on the CPU (like rs2::pointcloud) with the upload of 20 bytes per point,
+// compared to the upload of the raw depth (2 bytes per pixel) and the deprojection in the vertex shader
+static int benchDeprojection(BenchCloud& cloud, MRSettings& settings, int iterations, int width, int height)
+{
+	GlDepthCloud depthCloud;
+	if (!depthCloud.isSupported()) {
+		for (const char* name : { "deproject/cpu/points", "deproject/cpu/draw", "deproject/gpu/upload", "deproject/gpu/draw" })
+			skip(name, "no GLSL support by the OpenGL driver");
+		return EXIT_SUCCESS;
+	}
+
+	// same view as MRDemo::glPrepareScreen(), without rotation
+	glViewport(0, 0, width, height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(60, (double)width / height, 0.01f, 10.0f);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	gluLookAt(0, 0, 0, 0, 0, 1, 0, -1, 0);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_TEXTURE_2D);
+
+	GLuint colorTexture;
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, cloud.colorIntrinsics.width, cloud.colorIntrinsics.height, 0, GL_RGB, GL_UNSIGNED_BYTE, cloud.color.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	const int depthWidth = cloud.depthIntrinsics.width;
+	const int depthHeight = cloud.depthIntrinsics.height;
+	const size_t count = (size_t)depthWidth * depthHeight;
+	std::vector<rs2::vertex> vertices(count);
+	std::vector<rs2::texture_coordinate> tex_coords(count);
+	BenchScene<MRScene> scene(settings);
+	depthCloud.setCamera(cloud.depthScale, cloud.depthIntrinsics, cloud.colorIntrinsics, cloud.depthToColor);
+
+	auto cpuPath = [&]() {
+		deprojectCPU(cloud, vertices.data(), tex_coords.data());
+		scene.processPointCloud(vertices.data(), tex_coords.data(), count);
+		scene.draw();
+	};
+	auto gpuPath = [&]() {
+		depthCloud.upload(cloud.depth.data(), depthWidth, depthHeight, depthWidth * sizeof(uint16_t));
+		depthCloud.draw(settings.scanMinZ, settings.scanMaxZ);
+	};
+
+	// both paths have to draw the same image
+	std::vector<uint8_t> cpuImage = renderImage(width, height, cpuPath);
+	std::vector<uint8_t> gpuImage = renderImage(width, height, gpuPath);
+	size_t covered = 0, differing = 0;
+	for (size_t i = 0; i < cpuImage.size(); i += 3)
+	{
+		bool background = cpuImage[i] == 153 && cpuImage[i + 1] == 153 && cpuImage[i + 2] == 153;
+		covered += background ? 0 : 1;
+		for (int c = 0; c < 3; c++) {
+			if (std::abs(cpuImage[i + c] - gpuImage[i + c]) > 8) {
+				differing++;
+				break;
+			}
+		}
+	}
+	std::cout << "deproject: " << covered << " pixels covered, " << differing << " differ between CPU and GPU" << std::endl;
+	if (differing > covered / 100) {
+		std::cerr << "deprojection on the GPU differs from the CPU" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	measure("deproject/cpu/points", count, iterations, [&]() {
+		deprojectCPU(cloud, vertices.data(), tex_coords.data());
+	});
+	measure("deproject/cpu/draw", count, iterations, [&]() {
+		cpuPath();
+		glFinish();
+	});
+	measure("deproject/gpu/upload", count, iterations, [&]() {
+		depthCloud.upload(cloud.depth.data(), depthWidth, depthHeight, depthWidth * sizeof(uint16_t));
+		glFinish();
+	});
+	measure("deproject/gpu/draw", count, iterations, [&]() {
+		gpuPath();
+		glFinish();
+	});
+
+	glDeleteTextures(1, &colorTexture);
+	return EXIT_SUCCESS;
+}
+
+// the headless window of MRDemo renders into GlFramebuffer: the same image as in the window, the frame rate without
+// the buffer swap, and the saved frames (PPM) hold the framebuffer
+static int benchOffscreen(BenchCloud& cloud, MRSettings& settings, int iterations, int width, int height)
+{
+	GlFramebuffer offscreen;
+	if (!offscreen.create(width, height)) {
+		std::cout << "offscreen rendering skipped, no framebuffer objects in " << glGetString(GL_RENDERER) << std::endl;
+		return EXIT_SUCCESS;
+	}
+	BenchScene<MRScene> scene(settings);
+	const size_t count = cloud.vertices.size();
+	auto drawPoints = [&]() {
+		scene.processPointCloud(cloud.vertices.data(), cloud.tex_coords.data(), count);
+		scene.draw();
+	};
+	std::vector<uint8_t> window = renderImage(width, height, drawPoints);
+	offscreen.bind();
+	std::vector<uint8_t> image = renderImage(width, height, drawPoints);
+	offscreen.unbind();
+	// the default framebuffer may hold more than the 8 bits per channel of the renderbuffer: rounding by one
+	size_t differing = 0;
+	for (size_t i = 0; i < image.size(); i++)
+		differing += std::abs(image[i] - window[i]) > 1 ? 1 : 0;
+	if (differing) {
+		std::cerr << "offscreen rendering differs from the window in " << differing << " color values" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::string path = "MRBench-frame.ppm";
+	offscreen.bind();
+	bool saved = offscreen.save(path);
+	offscreen.unbind();
+	std::ifstream file(path, std::ios::binary);
+	std::string magic;
+	int fileWidth = 0, fileHeight = 0, maxValue = 0;
+	file >> magic >> fileWidth >> fileHeight >> maxValue;
+	file.get();
+	std::vector<uint8_t> pixels(3 * (size_t)width * height);
+	file.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+	bool same = saved && file && magic == "P6" && fileWidth == width && fileHeight == height && maxValue == 255;
+	for (int y = 0; same && y < height; y++)	// top row first
+		same = !memcmp(&pixels[3 * (size_t)y * width], &image[3 * (size_t)(height - 1 - y) * width], 3 * (size_t)width);
+	file.close();
+	std::remove(path.c_str());
+	if (!same) {
+		std::cerr << "the saved frame differs from the framebuffer" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "offscreen: " << width << "x" << height << " as in the window, identical to the saved frame" << std::endl;
+
+	measureFrames("render/window", 3 * (size_t)width * height, iterations, [&]() {
+		renderImage(width, height, drawPoints);
+	});
+	offscreen.bind();
+	measureFrames("render/offscreen", 3 * (size_t)width * height, iterations, [&]() {
+		renderImage(width, height, drawPoints);
+	});
+	measureFrames("render/offscreen+save", 3 * (size_t)width * height, iterations, [&]() {
+		renderImage(width, height, drawPoints);
+		offscreen.save(path);
+	});
+	offscreen.unbind();
+	std::remove(path.c_str());
+	return EXIT_SUCCESS;
+}
+
+// the GPU stages of MRDemo by timestamp queries, read back FRAMES_IN_FLIGHT frames later: with glFinish() after each
+// frame none is skipped and the GPU time of the points lies within the wall time of the frame, a nested stage within
+// the enclosing one (llvmpipe takes the timestamps when it bins the commands, before rasterizing them, so its times
+// are close to 0); the queries must not slow the render loop down, which never waits for them
+static int benchGpuTimers(BenchCloud& cloud, MRSettings& settings, int iterations, int width, int height)
+{
+	GlTimerQueries& queries = GlTimerQueries::instance();
+	if (!queries.create()) {
+		std::cout << "GPU timers skipped, no timer queries in " << glGetString(GL_RENDERER) << std::endl;
+		return EXIT_SUCCESS;
+	}
+	BenchScene<MRScene> scene(settings);
+	scene.processPointCloud(cloud.vertices.data(), cloud.tex_coords.data(), cloud.vertices.size());
+	MRStageTimings timings;
+	auto drawFrame = [&]() {
+		queries.beginFrame(timings);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		GlTimerScope points(EMRStage::GPU_POINTS);
+		scene.draw();
+		GlTimerScope gizmo(EMRStage::GPU_GIZMO);	// nested, as the gizmo of the setup scene
+		scene.draw();
+	};
+
+	const int frames = 2 * GlTimerQueries::FRAMES_IN_FLIGHT + std::max(iterations, 10);
+	double wallMillis = 0.0;
+	for (int f = 0; f < frames; f++) {
+		auto start = std::chrono::steady_clock::now();
+		drawFrame();
+		glFinish();
+		wallMillis = std::max(wallMillis, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	MRStageTimings::Summary points = timings.summary(EMRStage::GPU_POINTS);
+	MRStageTimings::Summary gizmo = timings.summary(EMRStage::GPU_GIZMO);
+	std::cout << "GPU timers: " << queries.completedFrames() << " frames read back, " << queries.skippedFrames()
+		<< " skipped, points p50 " << std::fixed << std::setprecision(3) << points.p50 << " ms (nested " << gizmo.p50 << " ms), frame at most "
+		<< wallMillis << " ms" << std::endl;
+	if (queries.skippedFrames() != 0 || points.samples != (size_t)(frames - GlTimerQueries::FRAMES_IN_FLIGHT)
+		|| gizmo.samples != points.samples || points.max > wallMillis || gizmo.p50 > points.p50) {
+		std::cerr << "GPU timers miss frames or exceed the time of the frame" << std::endl;
+		queries.destroy();
+		return EXIT_FAILURE;
+	}
+
+	const size_t bytes = 3 * (size_t)width * height;
+	measureFrames("render/GPU timers", bytes, iterations, drawFrame);
+	queries.destroy();
+	measureFrames("render/no GPU timers", bytes, iterations, drawFrame);	// begin() and end() without queries
+	return EXIT_SUCCESS;
+}
+
+// MRSceneSnapshot before: every frozen point re-submitted per frame with glColor3f/glVertex3fv,
+// compared to GlSnapshotStore: uploaded once, one glDrawArrays() per snapshot
+static int benchSnapshots(BenchCloud& cloud, MRSettings& settings, int iterations, int width, int height)
+{
+	const size_t count = cloud.vertices.size();
+	std::vector<rs2::vertex> vertices(count);
+	std::vector<rs2::texture_coordinate> tex_coords(count);
+	std::vector<GlSnapshotStore::Color> colors(count);
+	const size_t n = compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count,
+		{ settings.scanMinZ, settings.scanMaxZ }, vertices.data(), tex_coords.data());
+	const float maxZ = settings.scanMaxZ;
+	for (size_t i = 0; i < n; i++) {
+		uint8_t c = (uint8_t)((maxZ - vertices[i].z) / maxZ * 255.f + 0.5f);
+		colors[i] = { c, c, c };
+	}
+
+	auto immediate = [&]() {
+		glBegin(GL_POINTS);
+		for (size_t i = 0; i < n; i++)
+		{
+			float c = (maxZ - vertices[i].z) / maxZ;
+			glColor3f(c, c, c);
+			glVertex3fv(vertices[i]);
+		}
+		glEnd();
+	};
+	GlSnapshotStore store(8, 64 << 20);
+	store.add(vertices.data(), colors.data(), n);
+
+	// the same image, up to the rounding of the color to 8 bits
+	glDisable(GL_TEXTURE_2D);
+	std::vector<uint8_t> before = renderImage(width, height, immediate);
+	std::vector<uint8_t> after = renderImage(width, height, [&]() { store.draw(); });
+	size_t differing = 0;
+	for (size_t i = 0; i < before.size(); i++)
+		differing += (std::abs(before[i] - after[i]) > 1) ? 1 : 0;
+	std::cout << "snapshot: " << n << " points, " << differing << " color values differ" << std::endl;
+	if (differing) {
+		std::cerr << "snapshot store draws another image than immediate mode" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// the CPU time per frame (submit), and until drawn
+	measure("snapshot/immediate/submit", n, iterations, [&]() { immediate(); });
+	measure("snapshot/store/submit", n, iterations, [&]() { store.draw(); });
+	glFinish();
+	measure("snapshot/immediate/draw", n, iterations, [&]() { immediate(); glFinish(); });
+	measure("snapshot/store/draw", n, iterations, [&]() { store.draw(); glFinish(); });
+
+	// the budget drops the oldest snapshots
+	GlSnapshotStore budget(3, 2 * n * GlSnapshotStore::BYTES_PER_POINT);
+	for (int i = 0; i < 4; i++)
+		budget.add(vertices.data(), colors.data(), n);
+	if (budget.size() != 2 || budget.bytes() != 2 * n * GlSnapshotStore::BYTES_PER_POINT) {
+		std::cerr << "snapshot store exceeds its budget: " << budget.size() << " snapshots, " << budget.bytes() << " bytes" << std::endl;
+		return EXIT_FAILURE;
+	}
+	glEnable(GL_TEXTURE_2D);
+	return EXIT_SUCCESS;
+}
+
+
+// snapshot files: exact round trip (positions within half a quantization step), the same image drawn
+// from the mapping, and the time to write and to load them compared to reading into memory and to export_to_ply()
+static int benchSnapshotFiles(BenchCloud& cloud, MRSettings& settings, int iterations, int width, int height)
+{
+	const size_t count = cloud.vertices.size();
+	std::vector<rs2::vertex> vertices(count);
+	std::vector<rs2::texture_coordinate> tex_coords(count);
+	std::vector<GlSnapshotStore::Color> colors(count);
+	const size_t n = compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count,
+		{ settings.scanMinZ, settings.scanMaxZ }, vertices.data(), tex_coords.data());
+	const float maxZ = settings.scanMaxZ;
+	for (size_t i = 0; i < n; i++) {
+		uint8_t c = (uint8_t)((maxZ - vertices[i].z) / maxZ * 255.f + 0.5f);
+		colors[i] = { c, c, c };
+	}
+	const uint8_t* rgb = reinterpret_cast<const uint8_t*>(colors.data());
+
+	const std::string directory = "MRBench-snapshots";
+	if (!createSnapshotDirectory(directory)) {
+		std::cerr << "cannot create " << directory << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string quantizedPath = directory + "/quantized.mrsnap";
+	const std::string floatPath = directory + "/float.mrsnap";
+	if (!writeSnapshotFile(quantizedPath, vertices.data(), tex_coords.data(), rgb, n, cloud.depthIntrinsics, true)
+		|| !writeSnapshotFile(floatPath, vertices.data(), tex_coords.data(), rgb, n, cloud.depthIntrinsics, false)) {
+		std::cerr << "cannot write the snapshot files" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	for (const std::string& path : { quantizedPath, floatPath })
+	{
+		MRMappedSnapshot file;
+		if (!file.open(path) || file.count() != n) {
+			std::cerr << "cannot map " << path << std::endl;
+			return EXIT_FAILURE;
+		}
+		const float step = file.header().quantization;
+		float maxError = 0.0f;
+		for (size_t i = 0; i < n; i++) {
+			rs2::vertex v = file.vertex(i);
+			maxError = std::max(maxError, std::abs(v.x - vertices[i].x));
+			maxError = std::max(maxError, std::abs(v.y - vertices[i].y));
+			maxError = std::max(maxError, std::abs(v.z - vertices[i].z));
+		}
+		std::cout << "snapshot file: " << path << ", " << n << " points, " << file.header().fileBytes << " bytes, quantization "
+			<< std::setprecision(6) << step * 1000.0f << "mm, max error " << maxError * 1000.0f << "mm" << std::endl;
+		// the rounding of the positions, and of the dequantization in float (a few ulp of 2m)
+		if (maxError > step / 2 + 1e-6f
+			|| memcmp(file.texCoords(), tex_coords.data(), n * sizeof(rs2::texture_coordinate))
+			|| memcmp(file.colors(), rgb, 3 * n)
+			|| memcmp(&file.header().intrinsics, &cloud.depthIntrinsics, sizeof(rs2_intrinsics))) {
+			std::cerr << "snapshot file " << path << " differs from the points written" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// the quantized positions drawn through the modelview matrix: the same image as the positions dequantized
+	// on the CPU, and close to the one of the positions before quantization (points on the edge of a pixel move)
+	auto loadMapped = [&](const std::string& path, GlSnapshotStore& store) {
+		MRMappedSnapshot file;
+		file.open(path);
+		float origin[3] = {};
+		float scale = 1.0f;
+		if (file.isQuantized()) {
+			file.origin(origin);
+			scale = file.header().quantization;
+		}
+		store.add(file.positions(), file.isQuantized() ? GL_SHORT : GL_FLOAT, origin, scale,
+			reinterpret_cast<const GlSnapshotStore::Color*>(file.colors()), file.count());
+	};
+	std::vector<rs2::vertex> dequantized(n);
+	{
+		MRMappedSnapshot file;
+		file.open(quantizedPath);
+		for (size_t i = 0; i < n; i++)
+			dequantized[i] = file.vertex(i);
+	}
+	GlSnapshotStore store(8, 64 << 20);
+	GlSnapshotStore loaded(8, 64 << 20);
+	store.add(vertices.data(), colors.data(), n);
+	loaded.add(dequantized.data(), colors.data(), n);
+	glDisable(GL_TEXTURE_2D);
+	std::vector<uint8_t> original = renderImage(width, height, [&]() { store.draw(); });
+	std::vector<uint8_t> expected = renderImage(width, height, [&]() { loaded.draw(); });
+	loaded.clear();
+	loadMapped(quantizedPath, loaded);
+	std::vector<uint8_t> mapped = renderImage(width, height, [&]() { loaded.draw(); });
+	glEnable(GL_TEXTURE_2D);
+	size_t differing = 0, moved = 0;
+	for (size_t i = 0; i < mapped.size(); i++) {
+		differing += (mapped[i] != expected[i]) ? 1 : 0;
+		moved += (mapped[i] != original[i]) ? 1 : 0;
+	}
+	std::cout << "snapshot file: " << differing << " color values differ from the positions dequantized on the CPU, "
+		<< moved << " of " << mapped.size() << " from the positions before quantization" << std::endl;
+	if (differing) {
+		std::cerr << "the quantized snapshot is drawn at other positions than stored" << std::endl;
+		return EXIT_FAILURE;
+	}
+	store.clear();
+	loaded.clear();
+
+	measure("snapfile/write/quantized", n, iterations, [&]() {
+		writeSnapshotFile(quantizedPath, vertices.data(), tex_coords.data(), rgb, n, cloud.depthIntrinsics, true);
+	});
+	measure("snapfile/write/float", n, iterations, [&]() {
+		writeSnapshotFile(floatPath, vertices.data(), tex_coords.data(), rgb, n, cloud.depthIntrinsics, false);
+	});
+	if (cloud.depthFrame && cloud.colorFrame) {
+		rs2::pointcloud pc;
+		pc.map_to(cloud.colorFrame);
+		rs2::points points = pc.calculate(cloud.depthFrame);
+		const std::string plyPath = directory + "/export.ply";
+		measure("snapfile/export_to_ply (all)", points.size(), iterations, [&]() { points.export_to_ply(plyPath, cloud.colorFrame); });
+		std::remove(plyPath.c_str());
+	}
+	else {
+		std::cout << "export_to_ply() skipped, needs the frames of a recording" << std::endl;
+	}
+
+	// the render thread only copies the arrays, the file is written by the saver
+	{
+		MRSnapshotSaver saver;
+		const std::string queuedPath = directory + "/queued.mrsnap";
+		measure("snapfile/save (queued)", n, iterations, [&]() {
+			saver.save(queuedPath, vertices.data(), tex_coords.data(), rgb, n, cloud.depthIntrinsics);
+		});
+		saver.flush();
+		if (saver.failed() || saver.saved() != (size_t)iterations + 1) {
+			std::cerr << "the saver wrote " << saver.saved() << " files, " << saver.failed() << " failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::remove(queuedPath.c_str());
+	}
+
+	// loading: mapped and uploaded from the mapping, against reading the file into memory first
+	for (const std::string& path : { quantizedPath, floatPath })
+	{
+		const std::string kind = (path == quantizedPath) ? "quantized" : "float";
+		measure("snapfile/map+upload/" + kind, n, iterations, [&]() {
+			loadMapped(path, loaded);
+			glFinish();
+			loaded.clear();
+		});
+		std::vector<char> buffer;
+		measure("snapfile/read+upload/" + kind, n, iterations, [&]() {
+			std::ifstream in(path, std::ios::binary | std::ios::ate);
+			buffer.resize((size_t)in.tellg());
+			in.seekg(0);
+			in.read(buffer.data(), buffer.size());
+			const MRSnapshotHeader& header = *reinterpret_cast<const MRSnapshotHeader*>(buffer.data());
+			float origin[3] = {};
+			for (int a = 0; a < 3; a++)
+				origin[a] = header.quantization > 0.0f ? header.boundsMin[a] + 32768.0f * header.quantization : 0.0f;
+			loaded.add(buffer.data() + header.positionOffset, header.quantization > 0.0f ? GL_SHORT : GL_FLOAT, origin,
+				header.quantization > 0.0f ? header.quantization : 1.0f,
+				reinterpret_cast<const GlSnapshotStore::Color*>(buffer.data() + header.colorOffset), header.count);
+			glFinish();
+			loaded.clear();
+		});
+	}
+	std::remove(quantizedPath.c_str());
+	std::remove(floatPath.c_str());
+	return EXIT_SUCCESS;
+}
+
+// all kernels and checks
+static int benchAll(BenchCloud& cloud, MRSettings& settings, int iterations, bool useGl)
+{
+	const size_t count = cloud.vertices.size();
+
+	std::vector<rs2::vertex> clippedVertices(count);
+	std::vector<rs2::texture_coordinate> clippedTexCoords(count);
+	size_t clippedCount = compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count,
+		{ settings.scanMinZ, settings.scanMaxZ }, clippedVertices.data(), clippedTexCoords.data());
+	std::cout << count << " points, " << clippedCount << " within scan range, " << iterations << " iterations, "
+		<< simdLevelName(simdLevel()) << std::endl;
+
+	GlPointBuffer out;
+
+	// dispatch: per-point virtual call vs. one call per batch
+	std::unique_ptr<PerPointScene> legacy(new PerPointScene());
+	perPointScene = legacy.get();
+	measure("dispatch/per-point", clippedCount, iterations, [&]() {
+		out.clear(clippedCount);
+		PerPointScene* scene = perPointScene;
+		for (size_t i = 0; i < clippedCount; i++)
+			scene->renderPoint(clippedVertices[i], clippedTexCoords[i], out);
+	});
+	MRScene plain(settings);
+	measure("dispatch/batch", clippedCount, iterations, [&]() {
+		out.clear(clippedCount);
+		plain.renderBatch(clippedVertices.data(), clippedTexCoords.data(), clippedCount, out);
+	});
+
+	// stream compaction of the scan range per SIMD level, at several ratios of surviving points
+	std::vector<float> sortedZ(count);
+	for (size_t i = 0; i < count; i++)
+		sortedZ[i] = cloud.vertices[i].z;
+	std::sort(sortedZ.begin(), sortedZ.end());
+	const size_t zeros = std::upper_bound(sortedZ.begin(), sortedZ.end(), 0.0f) - sortedZ.begin();
+	std::vector<rs2::vertex> referenceVertices(count);
+	std::vector<rs2::texture_coordinate> referenceTexCoords(count);
+	CompactionScratch scratch;
+	for (int survival : { 25, 50, 90 })
+	{
+		// points without depth (z==0) never survive, the ratio is relative to the whole cloud
+		ScanRange range{ 0.0f, sortedZ[std::min(count - 1, zeros + count * survival / 100)] };
+		size_t referenceCount = compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count, range,
+			referenceVertices.data(), referenceTexCoords.data(), SIMD_SCALAR);
+
+		for (ESimdLevel level : { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 })
+		{
+			const std::string name = "compact/" + std::string(simdLevelName(level)) + "/" + std::to_string(survival) + "%";
+			if (level > simdLevel()) {
+				skip(name, "not supported by the CPU");
+				continue;
+			}
+			size_t n = compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count, range,
+				clippedVertices.data(), clippedTexCoords.data(), level);
+			if (n != referenceCount
+				|| memcmp(clippedVertices.data(), referenceVertices.data(), n * sizeof(rs2::vertex))
+				|| memcmp(clippedTexCoords.data(), referenceTexCoords.data(), n * sizeof(rs2::texture_coordinate))) {
+				std::cerr << "compaction " << simdLevelName(level) << " differs from scalar" << std::endl;
+				return EXIT_FAILURE;
+			}
+			measure(name, count, iterations, [&]() {
+				compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count, range,
+					clippedVertices.data(), clippedTexCoords.data(), level);
+			});
+		}
+
+		// parallel compaction must scale with the cores and give the sequential result
+		auto compactParallel = [&](int threads) {
+			return compactScanRangeParallel(cloud.vertices.data(), cloud.tex_coords.data(), count, range,
+				clippedVertices.data(), clippedTexCoords.data(), scratch, threads);
+		};
+		bool same = measureThreads("compact/parallel/", "/" + std::to_string(survival) + "%", count, iterations, compactParallel,
+			[&](int threads) {
+				size_t n = compactParallel(threads);
+				if (n == referenceCount
+					&& !memcmp(clippedVertices.data(), referenceVertices.data(), n * sizeof(rs2::vertex))
+					&& !memcmp(clippedTexCoords.data(), referenceTexCoords.data(), n * sizeof(rs2::texture_coordinate)))
+					return true;
+				std::cerr << "parallel compaction with " << threads << " threads differs from scalar" << std::endl;
+				return false;
+			});
+		if (!same)
+			return EXIT_FAILURE;
+	}
+	clippedCount = compactScanRange(cloud.vertices.data(), cloud.tex_coords.data(), count,
+		{ settings.scanMinZ, settings.scanMaxZ }, clippedVertices.data(), clippedTexCoords.data());
+
+	// the kernel instantiations of the scenes: fused clipping on the whole cloud and on the clipped batch
+	BenchScene<MRScene> scenePlain(settings);
+	BenchScene<MRSceneSnapshot> sceneSnap(settings);
+	BenchScene<MRSceneIBC> sceneIBC(settings);
+	BenchScene<MRSceneTron> sceneTron(settings);
+	BenchScene<MRSceneStartrek> sceneStartrek(settings);
+	struct Instantiation {
+		const char* name;
+		MRScene* scene;
+		std::function<void()> animate;
+	} instantiations[] = {
+		{ "plain", &scenePlain, [&]() { scenePlain.animate(0, 1000); } },
+		{ "snapshot", &sceneSnap, [&]() { sceneSnap.animate(0, 1000); } },
+		{ "ibc", &sceneIBC, [&]() { sceneIBC.animate(2, 1000); } },
+		{ "tron/idle", &sceneTron, [&]() { sceneTron.animate(0, 1000); } },
+		{ "tron/disappear", &sceneTron, [&]() { sceneTron.animate(1, 5000); } },
+		{ "tron/appear", &sceneTron, [&]() { sceneTron.animate(2, 5000); } },
+		{ "startrek/idle", &sceneStartrek, [&]() { sceneStartrek.animate(0, 1000); } },
+		{ "startrek/beam", &sceneStartrek, [&]() { sceneStartrek.animate(1, 2500); } },
+	};
+	const ScanRange range{ settings.scanMinZ, settings.scanMaxZ };
+	for (auto& inst : instantiations)
+	{
+		inst.animate();
+
+		measure(std::string(inst.name) + "/clip", count, iterations, [&]() {
+			out.clear(2 * count);
+			inst.scene->clipAndRenderBatch(cloud.vertices.data(), cloud.tex_coords.data(), count, range, out);
+		});
+		measure(std::string(inst.name) + "/batch", clippedCount, iterations, [&]() {
+			out.clear(2 * clippedCount);
+			inst.scene->renderBatch(clippedVertices.data(), clippedTexCoords.data(), clippedCount, out);
+		});
+	}
+
+	if (benchScenes(cloud, settings, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchRandom(settings, clippedVertices.data(), clippedTexCoords.data(), clippedCount, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchTronSweep(settings, cloud, clippedVertices.data(), clippedTexCoords.data(), clippedCount, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchSimdDeprojection(cloud, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchFusedScan(cloud, settings, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchColorSampling(cloud, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchSynthetic(settings, iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchStageTimings(iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchLatency(iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (benchProfiler(iterations) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	// the rest needs an OpenGL context, from a hidden window
+	if (!useGl) {
+		std::cout << "texture upload, deprojection and rendering skipped (--no-gl)" << std::endl;
+		return EXIT_SUCCESS;
+	}
+	const int width = 1280, height = 720;
+	GLFWwindow* window = nullptr;
+	if (glfwInit()) {
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		window = glfwCreateWindow(width, height, "MRBench", nullptr, nullptr);
+	}
+	if (!window) {
+		std::cerr << "no OpenGL context for the texture upload, deprojection and rendering (--no-gl skips them)" << std::endl;
+		return EXIT_FAILURE;
+	}
+	glfwMakeContextCurrent(window);
+	glext::init();
+	std::cout << "OpenGL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER) << std::endl;
+
+	int result = benchTextureUpload(iterations);
+	if (result == EXIT_SUCCESS)
+		result = benchDeprojection(cloud, settings, iterations, width, height);
+	if (result == EXIT_SUCCESS)
+		result = benchSnapshots(cloud, settings, iterations, width, height);
+	if (result == EXIT_SUCCESS)
+		result = benchSnapshotFiles(cloud, settings, iterations, width, height);
+	if (result == EXIT_SUCCESS)
+		result = benchOffscreen(cloud, settings, iterations, width, height);
+	if (result == EXIT_SUCCESS)
+		result = benchGpuTimers(cloud, settings, iterations, width, height);
+	glfwDestroyWindow(window);
+	return result;
+}
+
+int main(int argc, char * argv[]) try
+{
+	std::vector<std::string> positional;
+	std::string jsonFile, baselineFile;
+	double threshold = 0.15;
+	bool scenesOnly = false, useGl = true;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--json" && hasValue)
+			jsonFile = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			baselineFile = argv[++i];
+		else if (arg == "--threshold" && hasValue)
+			threshold = std::strtod(argv[++i], nullptr) / 100.0;
+		else if (arg == "--scenes")
+			scenesOnly = true;
+		else if (arg == "--no-gl")
+			useGl = false;
+		else if (arg.compare(0, 2, "--") != 0 && positional.size() < 2)
+			positional.push_back(arg);
+		else {
+			std::cerr << "usage: MRBench [recording.bag|-] [iterations] [--scenes] [--no-gl] [--json results.json]"
+				<< " [--baseline baseline.json [--threshold percent]]" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	BenchCloud cloud;
+	std::string cloudName = "synthetic 848x480";
+	if (positional.size() > 0 && positional[0] != "-") {
+		std::cout << "Loading pointcloud from " << positional[0] << std::endl;
+		loadBag(positional[0].c_str(), cloud);
+		cloudName = positional[0];
+	}
+	else {
+		makeSynthetic(848, 480, cloud);
+	}
+	int iterations = (positional.size() > 1) ? std::stoi(positional[1]) : 50;
+
+	MRSettings settings;
+	settings.scanMaxZ = 1.73f;
+	settings.random_seed = 4711;	// the same effects on every run
+
+	int result = scenesOnly ? benchScenes(cloud, settings, iterations) : benchAll(cloud, settings, iterations, useGl);
+	if (!jsonFile.empty() && !writeResults(jsonFile, cloudName, iterations))
+		result = EXIT_FAILURE;
+	if (!baselineFile.empty() && compareBaseline(baselineFile, threshold) != EXIT_SUCCESS)
+		result = EXIT_FAILURE;
+	return result;
+}
+catch (const rs2::error & e)
+{
+	std::cerr << "RealSense error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n    " << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
+catch (const std::exception & e)
+{
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
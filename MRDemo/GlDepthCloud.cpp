@@ -0,0 +1,251 @@
+#include "GlDepthCloud.h"
+#include "GlExtensions.h"
+
+#include <iostream>
+#include <vector>
+
+// one vertex per depth pixel, gl_Vertex.xy holds the pixel coordinates
+static const char* vertexShaderSource = R"(
+#version 120
+uniform sampler2D depthTexture;
+uniform vec2 depthSize;
+uniform float depthUnits;		// m per normalized texel value (depth_scale * 65535)
+uniform vec2 scanRange;			// minZ exclusive, maxZ inclusive
+uniform vec4 depthPinhole;		// ppx, ppy, fx, fy
+uniform int depthModel;
+uniform float depthCoeffs[5];
+uniform mat3 rotation;			// extrinsics depth to color
+uniform vec3 translation;
+uniform vec4 colorPinhole;
+uniform int colorModel;
+uniform float colorCoeffs[5];
+uniform vec2 colorSize;
+
+void main()
+{
+	vec2 pixel = gl_Vertex.xy;
+	float z = texture2DLod(depthTexture, (pixel + 0.5) / depthSize, 0.0).r * depthUnits;
+	if (z > scanRange.y || z <= scanRange.x) {
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);		// beyond the far plane, dropped by clipping
+		return;
+	}
+
+	// rs2_deproject_pixel_to_point()
+	vec2 xy = (pixel - depthPinhole.xy) / depthPinhole.zw;
+	if (depthModel == 2) {		// RS2_DISTORTION_INVERSE_BROWN_CONRADY
+		float r2 = dot(xy, xy);
+		float f = 1.0 + depthCoeffs[0] * r2 + depthCoeffs[1] * r2 * r2 + depthCoeffs[4] * r2 * r2 * r2;
+		xy = vec2(xy.x * f + 2.0 * depthCoeffs[2] * xy.x * xy.y + depthCoeffs[3] * (r2 + 2.0 * xy.x * xy.x),
+		          xy.y * f + 2.0 * depthCoeffs[3] * xy.x * xy.y + depthCoeffs[2] * (r2 + 2.0 * xy.y * xy.y));
+	}
+	vec3 point = vec3(xy * z, z);
+
+	// rs2_transform_point_to_point() and rs2_project_point_to_pixel() into the color image
+	vec3 c = rotation * point + translation;
+	vec2 uv = c.xy / c.z;
+	if (colorModel == 1) {		// RS2_DISTORTION_MODIFIED_BROWN_CONRADY
+		float r2 = dot(uv, uv);
+		float f = 1.0 + colorCoeffs[0] * r2 + colorCoeffs[1] * r2 * r2 + colorCoeffs[4] * r2 * r2 * r2;
+		uv *= f;
+		uv = vec2(uv.x + 2.0 * colorCoeffs[2] * uv.x * uv.y + colorCoeffs[3] * (r2 + 2.0 * uv.x * uv.x),
+		          uv.y + 2.0 * colorCoeffs[3] * uv.x * uv.y + colorCoeffs[2] * (r2 + 2.0 * uv.y * uv.y));
+	}
+	uv = (uv * colorPinhole.zw + colorPinhole.xy) / colorSize;
+
+	gl_TexCoord[0] = vec4(uv, 0.0, 1.0);
+	gl_FrontColor = gl_Color;
+	gl_Position = gl_ModelViewProjectionMatrix * vec4(point, 1.0);
+}
+)";
+
+// same as the fixed function pipeline with GL_MODULATE
+static const char* fragmentShaderSource = R"(
+#version 120
+uniform sampler2D colorTexture;
+
+void main()
+{
+	gl_FragColor = texture2D(colorTexture, gl_TexCoord[0].st) * gl_Color;
+}
+)";
+
+static GLuint compileShader(GLenum type, const char* source)
+{
+	GLuint shader = glext::glCreateShader(type);
+	glext::glShaderSource(shader, 1, &source, nullptr);
+	glext::glCompileShader(shader);
+	GLint status = 0;
+	glext::glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		char log[1024];
+		glext::glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		std::cerr << "GlDepthCloud: shader compile failed: " << log << std::endl;
+		glext::glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+
+GlDepthCloud::~GlDepthCloud()
+{
+	if (program)
+		glext::glDeleteProgram(program);
+	if (pixelBuffer)
+		glext::glDeleteBuffers(1, &pixelBuffer);
+	if (depthTexture)
+		glDeleteTextures(1, &depthTexture);
+}
+
+bool GlDepthCloud::isSupported()
+{
+	if (!compiled && !failed)
+		failed = !compile();
+	return compiled;
+}
+
+bool GlDepthCloud::compile()
+{
+	if (!glext::hasShaders() || !glext::hasVBO())
+		return false;
+
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+	if (!vertexShader || !fragmentShader)
+		return false;
+
+	program = glext::glCreateProgram();
+	glext::glAttachShader(program, vertexShader);
+	glext::glAttachShader(program, fragmentShader);
+	glext::glLinkProgram(program);
+	glext::glDeleteShader(vertexShader);	// flagged, deleted with the program
+	glext::glDeleteShader(fragmentShader);
+	GLint status = 0;
+	glext::glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		char log[1024];
+		glext::glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+		std::cerr << "GlDepthCloud: program link failed: " << log << std::endl;
+		glext::glDeleteProgram(program);
+		program = 0;
+		return false;
+	}
+	auto uniform = [&](const char* name) { return glext::glGetUniformLocation(program, name); };
+	uniforms.colorTexture = uniform("colorTexture");
+	uniforms.depthTexture = uniform("depthTexture");
+	uniforms.depthSize = uniform("depthSize");
+	uniforms.depthUnits = uniform("depthUnits");
+	uniforms.scanRange = uniform("scanRange");
+	uniforms.depthPinhole = uniform("depthPinhole");
+	uniforms.depthModel = uniform("depthModel");
+	uniforms.depthCoeffs = uniform("depthCoeffs");
+	uniforms.rotation = uniform("rotation");
+	uniforms.translation = uniform("translation");
+	uniforms.colorPinhole = uniform("colorPinhole");
+	uniforms.colorModel = uniform("colorModel");
+	uniforms.colorCoeffs = uniform("colorCoeffs");
+	uniforms.colorSize = uniform("colorSize");
+	compiled = true;
+	return true;
+}
+
+void GlDepthCloud::setCamera(float depthScale, const rs2_intrinsics& depth, const rs2_intrinsics& color, const rs2_extrinsics& depthToColor)
+{
+	this->depthScale = depthScale;
+	depthIntrinsics = depth;
+	colorIntrinsics = color;
+	this->depthToColor = depthToColor;
+}
+
+void GlDepthCloud::upload(const rs2::depth_frame& depth)
+{
+	if (!depth || depth.get_profile().format() != RS2_FORMAT_Z16)
+		return;
+	upload(reinterpret_cast<const uint16_t*>(depth.get_data()), depth.get_width(), depth.get_height(), depth.get_stride_in_bytes());
+}
+
+void GlDepthCloud::upload(const uint16_t* data, int width, int height, int strideBytes)
+{
+	if (!isSupported())
+		return;
+
+	if (!depthTexture)
+		glGenTextures(1, &depthTexture);
+	// unit 1, as for drawing, keeps the color texture bound to unit 0
+	glext::glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, strideBytes / 2);
+	if (width != this->width || height != this->height)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE16, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_SHORT, data);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);	// no mipmaps, no blending of depths
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// the pixel coordinates only change with the resolution
+		std::vector<float> pixels(2 * (size_t)width * height);
+		for (int y = 0, i = 0; y < height; y++) {
+			for (int x = 0; x < width; x++, i += 2) {
+				pixels[i] = (float)x;
+				pixels[i + 1] = (float)y;
+			}
+		}
+		if (!pixelBuffer)
+			glext::glGenBuffers(1, &pixelBuffer);
+		glext::glBindBuffer(GL_ARRAY_BUFFER, pixelBuffer);
+		glext::glBufferData(GL_ARRAY_BUFFER, pixels.size() * sizeof(float), pixels.data(), GL_STATIC_DRAW);
+		glext::glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		this->width = width;
+		this->height = height;
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_SHORT, data);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glext::glActiveTexture(GL_TEXTURE0);
+}
+
+int GlDepthCloud::draw(float minZ, float maxZ)
+{
+	if (!isSupported() || !width || !height)
+		return 0;
+
+	glext::glUseProgram(program);
+	glext::glUniform1i(uniforms.colorTexture, 0);
+	glext::glUniform1i(uniforms.depthTexture, 1);
+	glext::glUniform2f(uniforms.depthSize, (float)width, (float)height);
+	glext::glUniform1f(uniforms.depthUnits, depthScale * 65535.f);
+	glext::glUniform2f(uniforms.scanRange, minZ, maxZ);
+	glext::glUniform4f(uniforms.depthPinhole, depthIntrinsics.ppx, depthIntrinsics.ppy, depthIntrinsics.fx, depthIntrinsics.fy);
+	glext::glUniform1i(uniforms.depthModel, depthIntrinsics.model);
+	glext::glUniform1fv(uniforms.depthCoeffs, 5, depthIntrinsics.coeffs);
+	glext::glUniformMatrix3fv(uniforms.rotation, 1, GL_FALSE, depthToColor.rotation);	// column-major as rs2_extrinsics
+	glext::glUniform3f(uniforms.translation, depthToColor.translation[0], depthToColor.translation[1], depthToColor.translation[2]);
+	glext::glUniform4f(uniforms.colorPinhole, colorIntrinsics.ppx, colorIntrinsics.ppy, colorIntrinsics.fx, colorIntrinsics.fy);
+	glext::glUniform1i(uniforms.colorModel, colorIntrinsics.model);
+	glext::glUniform1fv(uniforms.colorCoeffs, 5, colorIntrinsics.coeffs);
+	glext::glUniform2f(uniforms.colorSize, (float)colorIntrinsics.width, (float)colorIntrinsics.height);
+
+	glext::glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glext::glActiveTexture(GL_TEXTURE0);
+
+	glext::glBindBuffer(GL_ARRAY_BUFFER, pixelBuffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, (const GLvoid*)0);
+	glDrawArrays(GL_POINTS, 0, width * height);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glext::glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glext::glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glext::glActiveTexture(GL_TEXTURE0);
+	glext::glUseProgram(0);
+	return width * height;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include "GlTypes.h"
+
+#include <cstdint>
+
+//////////////////////////////////////////////
+// Point-cloud deprojected on the GPU       //
+//////////////////////////////////////////////
+// Uploads the raw Z16 depth image (2 bytes per pixel instead of 20 for xyz+uv) into a texture
+// and draws one point per pixel from a static vertex buffer of pixel coordinates.
+// The vertex shader deprojects the pixels like rs2_deproject_pixel_to_point(), maps them
+// into the color image like rs2::pointcloud::map_to() and drops the points outside of the scan range.
+// Requires OpenGL 2.0 with texture fetches in the vertex shader (also offered by Mesa's llvmpipe).
+class GlDepthCloud
+{
+	GLuint program = 0;
+	GLuint depthTexture = 0;
+	GLuint pixelBuffer = 0;		// static vbo with the pixel coordinates
+	int width = 0;				// of the depth texture and the pixel buffer
+	int height = 0;
+	bool compiled = false;
+	bool failed = false;		// no shader support or the program did not compile
+
+	// locations of the uniforms, looked up once by compile()
+	struct Uniforms
+	{
+		GLint colorTexture, depthTexture, depthSize, depthUnits, scanRange;
+		GLint depthPinhole, depthModel, depthCoeffs, rotation, translation;
+		GLint colorPinhole, colorModel, colorCoeffs, colorSize;
+	} uniforms = {};
+
+	float depthScale = 0.001f;	// m per depth unit
+	rs2_intrinsics depthIntrinsics = {};
+	rs2_intrinsics colorIntrinsics = {};
+	rs2_extrinsics depthToColor = {};
+
+public:
+	GlDepthCloud() {}
+	GlDepthCloud(const GlDepthCloud&) = delete;
+	GlDepthCloud& operator=(const GlDepthCloud&) = delete;
+	~GlDepthCloud();
+
+	// compiles the program on the first call, requires a current OpenGL context
+	bool isSupported();
+
+	void setCamera(float depthScale, const rs2_intrinsics& depth, const rs2_intrinsics& color, const rs2_extrinsics& depthToColor);
+	float getDepthScale() const { return depthScale; }
+
+	void upload(const rs2::depth_frame& depth);
+	void upload(const uint16_t* data, int width, int height, int strideBytes);
+
+	// draws the uploaded depth, textured with the color texture bound to unit 0
+	// returns the number of points submitted, i.e. the pixels of the depth image (the shader clips to the scan range)
+	int draw(float minZ, float maxZ);
+
+private:
+	bool compile();
+};
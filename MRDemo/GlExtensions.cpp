@@ -0,0 +1,167 @@
+#include "GlExtensions.h"
+
+#include <cstdlib>
+
+namespace glext
+{
+	PFNGENBUFFERS glGenBuffers = nullptr;
+	PFNDELETEBUFFERS glDeleteBuffers = nullptr;
+	PFNBINDBUFFER glBindBuffer = nullptr;
+	PFNBUFFERDATA glBufferData = nullptr;
+	PFNBUFFERSUBDATA glBufferSubData = nullptr;
+	PFNMAPBUFFER glMapBuffer = nullptr;
+	PFNUNMAPBUFFER glUnmapBuffer = nullptr;
+	PFNTEXSTORAGE2D glTexStorage2D = nullptr;
+
+	PFNACTIVETEXTURE glActiveTexture = nullptr;
+	PFNCREATESHADER glCreateShader = nullptr;
+	PFNDELETESHADER glDeleteShader = nullptr;
+	PFNSHADERSOURCE glShaderSource = nullptr;
+	PFNCOMPILESHADER glCompileShader = nullptr;
+	PFNGETSHADERIV glGetShaderiv = nullptr;
+	PFNGETSHADERINFOLOG glGetShaderInfoLog = nullptr;
+	PFNCREATEPROGRAM glCreateProgram = nullptr;
+	PFNDELETEPROGRAM glDeleteProgram = nullptr;
+	PFNATTACHSHADER glAttachShader = nullptr;
+	PFNLINKPROGRAM glLinkProgram = nullptr;
+	PFNGETPROGRAMIV glGetProgramiv = nullptr;
+	PFNGETPROGRAMINFOLOG glGetProgramInfoLog = nullptr;
+	PFNUSEPROGRAM glUseProgram = nullptr;
+	PFNGETUNIFORMLOCATION glGetUniformLocation = nullptr;
+	PFNUNIFORM1I glUniform1i = nullptr;
+	PFNUNIFORM1F glUniform1f = nullptr;
+	PFNUNIFORM2F glUniform2f = nullptr;
+	PFNUNIFORM3F glUniform3f = nullptr;
+	PFNUNIFORM4F glUniform4f = nullptr;
+	PFNUNIFORM1FV glUniform1fv = nullptr;
+	PFNUNIFORMMATRIX3FV glUniformMatrix3fv = nullptr;
+
+	PFNGENFRAMEBUFFERS glGenFramebuffers = nullptr;
+	PFNDELETEFRAMEBUFFERS glDeleteFramebuffers = nullptr;
+	PFNBINDFRAMEBUFFER glBindFramebuffer = nullptr;
+	PFNCHECKFRAMEBUFFERSTATUS glCheckFramebufferStatus = nullptr;
+	PFNGENRENDERBUFFERS glGenRenderbuffers = nullptr;
+	PFNDELETERENDERBUFFERS glDeleteRenderbuffers = nullptr;
+	PFNBINDRENDERBUFFER glBindRenderbuffer = nullptr;
+	PFNRENDERBUFFERSTORAGE glRenderbufferStorage = nullptr;
+	PFNFRAMEBUFFERRENDERBUFFER glFramebufferRenderbuffer = nullptr;
+
+	PFNGENQUERIES glGenQueries = nullptr;
+	PFNDELETEQUERIES glDeleteQueries = nullptr;
+	PFNQUERYCOUNTER glQueryCounter = nullptr;
+	PFNGETQUERYOBJECTIV glGetQueryObjectiv = nullptr;
+	PFNGETQUERYOBJECTUI64V glGetQueryObjectui64v = nullptr;
+
+	static int version = 0;		// of the context, major * 10 + minor
+	static bool pixelBufferObject = false;
+	static bool textureStorage = false;
+	static bool framebufferObject = false;
+	static bool timerQuery = false;
+
+	template<typename T>
+	static void load(T& proc, const char* name)
+	{
+		proc = reinterpret_cast<T>(glfwGetProcAddress(name));
+	}
+
+	bool init()
+	{
+		load(glGenBuffers, "glGenBuffers");
+		load(glDeleteBuffers, "glDeleteBuffers");
+		load(glBindBuffer, "glBindBuffer");
+		load(glBufferData, "glBufferData");
+		load(glBufferSubData, "glBufferSubData");
+		load(glMapBuffer, "glMapBuffer");
+		load(glUnmapBuffer, "glUnmapBuffer");
+		load(glTexStorage2D, "glTexStorage2D");
+
+		load(glActiveTexture, "glActiveTexture");
+		load(glCreateShader, "glCreateShader");
+		load(glDeleteShader, "glDeleteShader");
+		load(glShaderSource, "glShaderSource");
+		load(glCompileShader, "glCompileShader");
+		load(glGetShaderiv, "glGetShaderiv");
+		load(glGetShaderInfoLog, "glGetShaderInfoLog");
+		load(glCreateProgram, "glCreateProgram");
+		load(glDeleteProgram, "glDeleteProgram");
+		load(glAttachShader, "glAttachShader");
+		load(glLinkProgram, "glLinkProgram");
+		load(glGetProgramiv, "glGetProgramiv");
+		load(glGetProgramInfoLog, "glGetProgramInfoLog");
+		load(glUseProgram, "glUseProgram");
+		load(glGetUniformLocation, "glGetUniformLocation");
+		load(glUniform1i, "glUniform1i");
+		load(glUniform1f, "glUniform1f");
+		load(glUniform2f, "glUniform2f");
+		load(glUniform3f, "glUniform3f");
+		load(glUniform4f, "glUniform4f");
+		load(glUniform1fv, "glUniform1fv");
+		load(glUniformMatrix3fv, "glUniformMatrix3fv");
+
+		load(glGenFramebuffers, "glGenFramebuffers");
+		load(glDeleteFramebuffers, "glDeleteFramebuffers");
+		load(glBindFramebuffer, "glBindFramebuffer");
+		load(glCheckFramebufferStatus, "glCheckFramebufferStatus");
+		load(glGenRenderbuffers, "glGenRenderbuffers");
+		load(glDeleteRenderbuffers, "glDeleteRenderbuffers");
+		load(glBindRenderbuffer, "glBindRenderbuffer");
+		load(glRenderbufferStorage, "glRenderbufferStorage");
+		load(glFramebufferRenderbuffer, "glFramebufferRenderbuffer");
+
+		load(glGenQueries, "glGenQueries");
+		load(glDeleteQueries, "glDeleteQueries");
+		load(glQueryCounter, "glQueryCounter");
+		load(glGetQueryObjectiv, "glGetQueryObjectiv");
+		load(glGetQueryObjectui64v, "glGetQueryObjectui64v");
+
+		// the entry points may resolve without being supported (e.g. Mesa), the version tells
+		// "<major>.<minor>[.<release>] <vendor info>", parsed without sscanf() (C4996 is an error with /sdl)
+		const char* versionString = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+		if (versionString) {
+			char* end = nullptr;
+			long major = strtol(versionString, &end, 10);
+			if (end != versionString && *end == '.')
+				version = (int)(major * 10 + strtol(end + 1, nullptr, 10));
+		}
+		pixelBufferObject = version >= 21 || glfwExtensionSupported("GL_ARB_pixel_buffer_object");
+		textureStorage = version >= 42 || glfwExtensionSupported("GL_ARB_texture_storage");
+		framebufferObject = version >= 30 || glfwExtensionSupported("GL_ARB_framebuffer_object");
+		timerQuery = version >= 33 || glfwExtensionSupported("GL_ARB_timer_query");
+		return hasVBO();
+	}
+
+	bool hasVBO()
+	{
+		return glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData && glBufferSubData;
+	}
+
+	bool hasPBO()
+	{
+		return hasVBO() && glMapBuffer && glUnmapBuffer && pixelBufferObject;
+	}
+
+	bool hasTexStorage()
+	{
+		return glTexStorage2D && textureStorage;
+	}
+
+	bool hasFBO()
+	{
+		return glGenFramebuffers && glDeleteFramebuffers && glBindFramebuffer && glCheckFramebufferStatus
+			&& glGenRenderbuffers && glDeleteRenderbuffers && glBindRenderbuffer && glRenderbufferStorage
+			&& glFramebufferRenderbuffer && framebufferObject;
+	}
+
+	bool hasTimerQuery()
+	{
+		return glGenQueries && glDeleteQueries && glQueryCounter && glGetQueryObjectiv && glGetQueryObjectui64v && timerQuery;
+	}
+
+	bool hasShaders()
+	{
+		return glActiveTexture && glCreateShader && glDeleteShader && glShaderSource && glCompileShader
+			&& glGetShaderiv && glGetShaderInfoLog && glCreateProgram && glDeleteProgram && glAttachShader
+			&& glLinkProgram && glGetProgramiv && glGetProgramInfoLog && glUseProgram && glGetUniformLocation
+			&& glUniform1i && glUniform1f && glUniform2f && glUniform3f && glUniform4f && glUniform1fv && glUniformMatrix3fv;
+	}
+}
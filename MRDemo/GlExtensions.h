@@ -0,0 +1,167 @@
+#pragma once
+
+#include "GlTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+
+//////////////////////////////////////////////////////////////////////////
+// OpenGL entry points beyond 1.1                                       //
+// opengl32.lib on Windows only exports OpenGL 1.1, everything newer   //
+// has to be resolved at runtime from the current context.             //
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#define GL_TEXTURE1 0x84C1
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 0x88B9
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+
+namespace glext
+{
+	typedef void (APIENTRY *PFNGENBUFFERS)(GLsizei n, GLuint* buffers);
+	typedef void (APIENTRY *PFNDELETEBUFFERS)(GLsizei n, const GLuint* buffers);
+	typedef void (APIENTRY *PFNBINDBUFFER)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY *PFNBUFFERDATA)(GLenum target, ptrdiff_t size, const void* data, GLenum usage);
+	typedef void (APIENTRY *PFNBUFFERSUBDATA)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void* data);
+	typedef void* (APIENTRY *PFNMAPBUFFER)(GLenum target, GLenum access);
+	typedef GLboolean (APIENTRY *PFNUNMAPBUFFER)(GLenum target);
+	typedef void (APIENTRY *PFNTEXSTORAGE2D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+
+	typedef void (APIENTRY *PFNACTIVETEXTURE)(GLenum texture);
+	typedef GLuint (APIENTRY *PFNCREATESHADER)(GLenum type);
+	typedef void (APIENTRY *PFNDELETESHADER)(GLuint shader);
+	typedef void (APIENTRY *PFNSHADERSOURCE)(GLuint shader, GLsizei count, const char* const* string, const GLint* length);
+	typedef void (APIENTRY *PFNCOMPILESHADER)(GLuint shader);
+	typedef void (APIENTRY *PFNGETSHADERIV)(GLuint shader, GLenum pname, GLint* params);
+	typedef void (APIENTRY *PFNGETSHADERINFOLOG)(GLuint shader, GLsizei bufSize, GLsizei* length, char* infoLog);
+	typedef GLuint (APIENTRY *PFNCREATEPROGRAM)();
+	typedef void (APIENTRY *PFNDELETEPROGRAM)(GLuint program);
+	typedef void (APIENTRY *PFNATTACHSHADER)(GLuint program, GLuint shader);
+	typedef void (APIENTRY *PFNLINKPROGRAM)(GLuint program);
+	typedef void (APIENTRY *PFNGETPROGRAMIV)(GLuint program, GLenum pname, GLint* params);
+	typedef void (APIENTRY *PFNGETPROGRAMINFOLOG)(GLuint program, GLsizei bufSize, GLsizei* length, char* infoLog);
+	typedef void (APIENTRY *PFNUSEPROGRAM)(GLuint program);
+	typedef GLint (APIENTRY *PFNGETUNIFORMLOCATION)(GLuint program, const char* name);
+	typedef void (APIENTRY *PFNUNIFORM1I)(GLint location, GLint v0);
+	typedef void (APIENTRY *PFNUNIFORM1F)(GLint location, GLfloat v0);
+	typedef void (APIENTRY *PFNUNIFORM2F)(GLint location, GLfloat v0, GLfloat v1);
+	typedef void (APIENTRY *PFNUNIFORM3F)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+	typedef void (APIENTRY *PFNUNIFORM4F)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+	typedef void (APIENTRY *PFNUNIFORM1FV)(GLint location, GLsizei count, const GLfloat* value);
+	typedef void (APIENTRY *PFNUNIFORMMATRIX3FV)(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+	typedef void (APIENTRY *PFNGENFRAMEBUFFERS)(GLsizei n, GLuint* framebuffers);
+	typedef void (APIENTRY *PFNDELETEFRAMEBUFFERS)(GLsizei n, const GLuint* framebuffers);
+	typedef void (APIENTRY *PFNBINDFRAMEBUFFER)(GLenum target, GLuint framebuffer);
+	typedef GLenum (APIENTRY *PFNCHECKFRAMEBUFFERSTATUS)(GLenum target);
+	typedef void (APIENTRY *PFNGENRENDERBUFFERS)(GLsizei n, GLuint* renderbuffers);
+	typedef void (APIENTRY *PFNDELETERENDERBUFFERS)(GLsizei n, const GLuint* renderbuffers);
+	typedef void (APIENTRY *PFNBINDRENDERBUFFER)(GLenum target, GLuint renderbuffer);
+	typedef void (APIENTRY *PFNRENDERBUFFERSTORAGE)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+	typedef void (APIENTRY *PFNFRAMEBUFFERRENDERBUFFER)(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+	typedef void (APIENTRY *PFNGENQUERIES)(GLsizei n, GLuint* ids);
+	typedef void (APIENTRY *PFNDELETEQUERIES)(GLsizei n, const GLuint* ids);
+	typedef void (APIENTRY *PFNQUERYCOUNTER)(GLuint id, GLenum target);
+	typedef void (APIENTRY *PFNGETQUERYOBJECTIV)(GLuint id, GLenum pname, GLint* params);
+	typedef void (APIENTRY *PFNGETQUERYOBJECTUI64V)(GLuint id, GLenum pname, uint64_t* params);
+
+	extern PFNGENBUFFERS glGenBuffers;
+	extern PFNDELETEBUFFERS glDeleteBuffers;
+	extern PFNBINDBUFFER glBindBuffer;
+	extern PFNBUFFERDATA glBufferData;
+	extern PFNBUFFERSUBDATA glBufferSubData;
+	extern PFNMAPBUFFER glMapBuffer;
+	extern PFNUNMAPBUFFER glUnmapBuffer;
+	extern PFNTEXSTORAGE2D glTexStorage2D;
+
+	extern PFNACTIVETEXTURE glActiveTexture;
+	extern PFNCREATESHADER glCreateShader;
+	extern PFNDELETESHADER glDeleteShader;
+	extern PFNSHADERSOURCE glShaderSource;
+	extern PFNCOMPILESHADER glCompileShader;
+	extern PFNGETSHADERIV glGetShaderiv;
+	extern PFNGETSHADERINFOLOG glGetShaderInfoLog;
+	extern PFNCREATEPROGRAM glCreateProgram;
+	extern PFNDELETEPROGRAM glDeleteProgram;
+	extern PFNATTACHSHADER glAttachShader;
+	extern PFNLINKPROGRAM glLinkProgram;
+	extern PFNGETPROGRAMIV glGetProgramiv;
+	extern PFNGETPROGRAMINFOLOG glGetProgramInfoLog;
+	extern PFNUSEPROGRAM glUseProgram;
+	extern PFNGETUNIFORMLOCATION glGetUniformLocation;
+	extern PFNUNIFORM1I glUniform1i;
+	extern PFNUNIFORM1F glUniform1f;
+	extern PFNUNIFORM2F glUniform2f;
+	extern PFNUNIFORM3F glUniform3f;
+	extern PFNUNIFORM4F glUniform4f;
+	extern PFNUNIFORM1FV glUniform1fv;
+	extern PFNUNIFORMMATRIX3FV glUniformMatrix3fv;
+
+	extern PFNGENFRAMEBUFFERS glGenFramebuffers;
+	extern PFNDELETEFRAMEBUFFERS glDeleteFramebuffers;
+	extern PFNBINDFRAMEBUFFER glBindFramebuffer;
+	extern PFNCHECKFRAMEBUFFERSTATUS glCheckFramebufferStatus;
+	extern PFNGENRENDERBUFFERS glGenRenderbuffers;
+	extern PFNDELETERENDERBUFFERS glDeleteRenderbuffers;
+	extern PFNBINDRENDERBUFFER glBindRenderbuffer;
+	extern PFNRENDERBUFFERSTORAGE glRenderbufferStorage;
+	extern PFNFRAMEBUFFERRENDERBUFFER glFramebufferRenderbuffer;
+
+	extern PFNGENQUERIES glGenQueries;
+	extern PFNDELETEQUERIES glDeleteQueries;
+	extern PFNQUERYCOUNTER glQueryCounter;
+	extern PFNGETQUERYOBJECTIV glGetQueryObjectiv;
+	extern PFNGETQUERYOBJECTUI64V glGetQueryObjectui64v;
+
+	bool init();		// resolves all entry points, requires a current OpenGL context
+	bool hasVBO();		// vertex buffer objects (OpenGL 1.5)
+	bool hasShaders();	// GLSL programs and multi-texturing (OpenGL 2.0)
+	bool hasPBO();		// pixel buffer objects for texture uploads (OpenGL 2.1)
+	bool hasTexStorage();	// immutable texture storage (OpenGL 4.2)
+	bool hasFBO();		// framebuffer objects with renderbuffers (OpenGL 3.0)
+	bool hasTimerQuery();	// GPU timestamps (OpenGL 3.3)
+}
@@ -0,0 +1,74 @@
+#include "GlFramebuffer.h"
+#include "GlExtensions.h"
+
+#include <iostream>
+#include <fstream>
+
+GlFramebuffer::~GlFramebuffer()
+{
+	if (framebuffer)
+		glext::glDeleteFramebuffers(1, &framebuffer);
+	if (colorBuffer)
+		glext::glDeleteRenderbuffers(1, &colorBuffer);
+	if (depthBuffer)
+		glext::glDeleteRenderbuffers(1, &depthBuffer);
+}
+
+bool GlFramebuffer::create(int width, int height)
+{
+	if (!glext::hasFBO())
+		return false;
+
+	glext::glGenRenderbuffers(1, &colorBuffer);
+	glext::glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glext::glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glext::glGenRenderbuffers(1, &depthBuffer);
+	glext::glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glext::glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glext::glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glext::glGenFramebuffers(1, &framebuffer);
+	glext::glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glext::glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glext::glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	GLenum status = glext::glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glext::glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "GlFramebuffer: incomplete framebuffer, status 0x" << std::hex << status << std::dec << std::endl;
+		glext::glDeleteFramebuffers(1, &framebuffer);
+		framebuffer = 0;
+		return false;
+	}
+	this->width = width;
+	this->height = height;
+	return true;
+}
+
+void GlFramebuffer::bind()
+{
+	glext::glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+void GlFramebuffer::unbind()
+{
+	glext::glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool GlFramebuffer::save(const std::string& path)
+{
+	if (!framebuffer)
+		return false;
+	pixels.resize(3 * (size_t)width * height);
+	glext::glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n" << width << " " << height << "\n255\n";
+	// OpenGL reads the bottom row first
+	for (int y = height - 1; y >= 0; y--)
+		file.write(reinterpret_cast<const char*>(pixels.data() + 3 * (size_t)y * width), 3 * (size_t)width);
+	return (bool)file;
+}
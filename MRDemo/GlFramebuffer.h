@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GlTypes.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////
+// Offscreen render target                  //
+//////////////////////////////////////////////
+// Framebuffer object with a color (RGBA8) and a depth renderbuffer, for rendering without showing the frames:
+// the size does not depend on a window or screen and nothing waits for the buffer swap.
+// Requires OpenGL 3.0 or GL_ARB_framebuffer_object (also offered by Mesa's llvmpipe).
+class GlFramebuffer
+{
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;	// read back for save()
+
+public:
+	GlFramebuffer() {}
+	GlFramebuffer(const GlFramebuffer&) = delete;
+	GlFramebuffer& operator=(const GlFramebuffer&) = delete;
+	~GlFramebuffer();
+
+	// false if framebuffer objects are not supported or the framebuffer is incomplete
+	bool create(int width, int height);
+	bool isCreated() const { return framebuffer != 0; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	void bind();		// renders into the framebuffer instead of the window
+	void unbind();
+
+	// reads the pixels back and writes them as binary PPM (RGB, top row first)
+	bool save(const std::string& path);
+};
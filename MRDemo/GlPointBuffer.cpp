@@ -0,0 +1,72 @@
+#include "GlPointBuffer.h"
+#include "GlExtensions.h"
+
+GlPointBuffer::~GlPointBuffer()
+{
+	if (vbo)
+		glext::glDeleteBuffers(1, &vbo);
+}
+
+void GlPointBuffer::clear(size_t capacity)
+{
+	uploaded = false;
+	vertices.clear();
+	tex_coords.clear();
+	if (capacity > vertices.capacity()) {
+		vertices.reserve(capacity);
+		tex_coords.reserve(capacity);
+	}
+}
+
+void GlPointBuffer::draw(bool useVBO)
+{
+	if (vertices.empty())
+		return;
+
+	if (!useVBO)
+	{
+		// the texture coordinate before its vertex: the former glVertex3fv/glTexCoord2fv order gave every point
+		// the texture coordinate of the previous one
+		glBegin(GL_POINTS);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			glTexCoord2fv(tex_coords[i]);
+			glVertex3fv(vertices[i]);
+		}
+		glEnd();
+		return;
+	}
+
+	const ptrdiff_t vertexBytes = vertices.size() * sizeof(rs2::vertex);
+	const ptrdiff_t texCoordBytes = tex_coords.size() * sizeof(rs2::texture_coordinate);
+	const GLvoid* vertexPtr = vertices.data();
+	const GLvoid* texCoordPtr = tex_coords.data();
+
+	if (glext::hasVBO())
+	{
+		if (!vbo)
+			glext::glGenBuffers(1, &vbo);
+		glext::glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		if (!uploaded) {
+			// re-specify the whole store each frame, so the driver can orphan the one still in use
+			glext::glBufferData(GL_ARRAY_BUFFER, vertexBytes + texCoordBytes, nullptr, GL_STREAM_DRAW);
+			glext::glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, vertexPtr);
+			glext::glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, texCoordBytes, texCoordPtr);
+			uploaded = true;
+		}
+		// with a bound buffer the pointers are offsets into it
+		vertexPtr = (const GLvoid*)0;
+		texCoordPtr = (const GLvoid*)vertexBytes;
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, vertexPtr);
+	glTexCoordPointer(2, GL_FLOAT, 0, texCoordPtr);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)vertices.size());
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	if (vbo)
+		glext::glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <vector>
+
+#include "GlTypes.h"
+
+//////////////////////////////////////////////
+// Point-cloud rendering with a single draw //
+//////////////////////////////////////////////
+// Collects vertices and texture coordinates of one frame into contiguous arrays,
+// streams them into a vertex buffer object and draws them with one glDrawArrays() call.
+// Drawing the same points again (no clear/add in between) re-uses the buffer without a new upload.
+// Falls back to client-side vertex arrays if the driver does not offer VBOs,
+// or to glBegin/glVertex calls on request (to compare both ways of submission). Those replay the filled buffer,
+// so they compare the submission only, not the former per-point path with the scene kernels inside glBegin/glEnd.
+class GlPointBuffer
+{
+	GLuint vbo = 0;
+	bool uploaded = false;	// the vbo holds the current points, so draw() can skip the transfer
+	std::vector<rs2::vertex> vertices;
+	std::vector<rs2::texture_coordinate> tex_coords;
+
+public:
+	GlPointBuffer() {}
+	GlPointBuffer(const GlPointBuffer&) = delete;
+	GlPointBuffer& operator=(const GlPointBuffer&) = delete;
+	~GlPointBuffer();
+
+	void clear(size_t capacity = 0);
+	void add(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		uploaded = false;
+		vertices.push_back(vertex);
+		tex_coords.push_back(tex_coord);
+	}
+	// appends count points at once, for effects which keep ranges of a batch unchanged
+	void add(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count)
+	{
+		uploaded = false;
+		this->vertices.insert(this->vertices.end(), vertices, vertices + count);
+		this->tex_coords.insert(this->tex_coords.end(), tex_coords, tex_coords + count);
+	}
+	size_t size() const { return vertices.size(); }
+	const std::vector<rs2::vertex>& points() const { return vertices; }
+
+	void draw(bool useVBO = true);
+};
@@ -0,0 +1,136 @@
+#include "GlSnapshotStore.h"
+#include "GlExtensions.h"
+#include "GlTimerQueries.h"
+
+
+GlSnapshotStore::GlSnapshotStore(size_t maxSlots, size_t budgetBytes) : maxSlots(maxSlots), budgetBytes(budgetBytes)
+{
+}
+
+GlSnapshotStore::~GlSnapshotStore()
+{
+	clear();
+}
+
+void GlSnapshotStore::setBudget(size_t maxSlots, size_t budgetBytes)
+{
+	this->maxSlots = maxSlots;
+	this->budgetBytes = budgetBytes;
+	evict();
+}
+
+size_t GlSnapshotStore::Snapshot::bytes() const
+{
+	return count * ((positionType == GL_FLOAT ? sizeof(float) : sizeof(int16_t)) * 3 + sizeof(Color));
+}
+
+bool GlSnapshotStore::add(const rs2::vertex* vertices, const Color* colors, size_t count)
+{
+	static const float origin[3] = { 0.0f, 0.0f, 0.0f };
+	return add(vertices, GL_FLOAT, origin, 1.0f, colors, count);
+}
+
+bool GlSnapshotStore::add(const void* positions, GLenum positionType, const float origin[3], float scale, const Color* colors, size_t count)
+{
+	Snapshot snapshot;
+	snapshot.count = count;
+	snapshot.positionType = positionType;
+	for (int a = 0; a < 3; a++)
+		snapshot.origin[a] = origin[a];
+	snapshot.scale = scale;
+	const size_t bytes = snapshot.bytes();
+	if (!count || !maxSlots || bytes > budgetBytes)
+		return false;
+
+	// make room first, so the old buffers can be released before the new one is allocated
+	while (!snapshots.empty() && (snapshots.size() >= maxSlots || usedBytes + bytes > budgetBytes))
+		dropOldest();
+
+	const ptrdiff_t colorBytes = count * sizeof(Color);
+	const ptrdiff_t positionBytes = bytes - colorBytes;
+	if (glext::hasVBO())
+	{
+		glext::glGenBuffers(1, &snapshot.vbo);
+		glext::glBindBuffer(GL_ARRAY_BUFFER, snapshot.vbo);
+		glext::glBufferData(GL_ARRAY_BUFFER, positionBytes + colorBytes, nullptr, GL_STATIC_DRAW);
+		glext::glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, positions);
+		glext::glBufferSubData(GL_ARRAY_BUFFER, positionBytes, colorBytes, colors);
+		glext::glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	else
+	{
+		const uint8_t* bytesIn = static_cast<const uint8_t*>(positions);
+		snapshot.positions.assign(bytesIn, bytesIn + positionBytes);
+		snapshot.colors.assign(colors, colors + count);
+	}
+	snapshots.push_back(std::move(snapshot));
+	usedBytes += bytes;
+	return true;
+}
+
+void GlSnapshotStore::dropOldest()
+{
+	if (snapshots.empty())
+		return;
+	Snapshot& oldest = snapshots.front();
+	if (oldest.vbo)
+		glext::glDeleteBuffers(1, &oldest.vbo);
+	usedBytes -= oldest.bytes();
+	snapshots.pop_front();
+}
+
+void GlSnapshotStore::clear()
+{
+	while (!snapshots.empty())
+		dropOldest();
+}
+
+void GlSnapshotStore::evict()
+{
+	while (!snapshots.empty() && (snapshots.size() > maxSlots || usedBytes > budgetBytes))
+		dropOldest();
+}
+
+int GlSnapshotStore::draw()
+{
+	if (snapshots.empty())
+		return 0;
+	GlTimerScope gpuTimer(EMRStage::GPU_POINTS);	// a further span of the points
+
+	// the colors are final, no texture to modulate them
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	size_t points = 0;
+	for (const Snapshot& snapshot : snapshots)
+	{
+		const GLvoid* positionPtr = snapshot.positions.data();
+		const GLvoid* colorPtr = snapshot.colors.data();
+		if (snapshot.vbo) {
+			// with a bound buffer the pointers are offsets into it
+			glext::glBindBuffer(GL_ARRAY_BUFFER, snapshot.vbo);
+			positionPtr = (const GLvoid*)0;
+			colorPtr = (const GLvoid*)(snapshot.bytes() - snapshot.count * sizeof(Color));
+		}
+		const bool scaled = snapshot.positionType != GL_FLOAT || snapshot.scale != 1.0f;
+		if (scaled) {
+			glMatrixMode(GL_MODELVIEW);
+			glPushMatrix();
+			glTranslatef(snapshot.origin[0], snapshot.origin[1], snapshot.origin[2]);
+			glScalef(snapshot.scale, snapshot.scale, snapshot.scale);
+		}
+		glVertexPointer(3, snapshot.positionType, 0, positionPtr);
+		glColorPointer(3, GL_UNSIGNED_BYTE, 0, colorPtr);
+		glDrawArrays(GL_POINTS, 0, (GLsizei)snapshot.count);
+		if (scaled)
+			glPopMatrix();
+		points += snapshot.count;
+	}
+	if (glext::hasVBO())
+		glext::glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glPopAttrib();
+	return (int)points;
+}
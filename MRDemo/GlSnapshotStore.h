@@ -0,0 +1,70 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "GlTypes.h"
+
+//////////////////////////////////////////////
+// Frozen point-clouds kept on the GPU      //
+//////////////////////////////////////////////
+// Every snapshot is uploaded once into a static vertex buffer of its exact size, holding the vertices
+// and a color per point (computed when it is captured), and drawn with one glDrawArrays() call:
+// no work per point on the CPU while it is shown.
+// Holds up to maxSlots snapshots within budgetBytes, adding one beyond either limit drops the oldest.
+// Snapshots mapped from files (MRSnapshotFile.h) are uploaded as they are stored: 16 bit positions,
+// scaled back to m by the modelview matrix while drawing.
+// Falls back to client-side arrays if the driver does not offer VBOs.
+class GlSnapshotStore
+{
+public:
+	struct Color { uint8_t r, g, b; };
+	static_assert(sizeof(Color) == 3, "colors are uploaded as packed rgb, as stored in the snapshot files");
+
+private:
+	struct Snapshot
+	{
+		GLuint vbo = 0;
+		size_t count = 0;
+		GLenum positionType = GL_FLOAT;		// or GL_SHORT, quantized
+		float origin[3] = {};				// m, position = origin + scale * stored position
+		float scale = 1.0f;
+		std::vector<uint8_t> positions;		// only without VBO support
+		std::vector<Color> colors;
+
+		size_t bytes() const;
+	};
+	std::deque<Snapshot> snapshots;		// oldest first
+	size_t maxSlots;
+	size_t budgetBytes;
+	size_t usedBytes = 0;
+
+public:
+	static const size_t BYTES_PER_POINT = sizeof(rs2::vertex) + sizeof(Color);	// of a snapshot with float positions
+
+	GlSnapshotStore(size_t maxSlots = 8, size_t budgetBytes = 64 << 20);
+	GlSnapshotStore(const GlSnapshotStore&) = delete;
+	GlSnapshotStore& operator=(const GlSnapshotStore&) = delete;
+	~GlSnapshotStore();
+
+	void setBudget(size_t maxSlots, size_t budgetBytes);
+
+	// uploads count points, requires a current OpenGL context; false if they exceed the budget on their own
+	bool add(const rs2::vertex* vertices, const Color* colors, size_t count);
+	// same for positions of positionType GL_FLOAT or GL_SHORT (xyz), drawn at origin + scale * position
+	bool add(const void* positions, GLenum positionType, const float origin[3], float scale, const Color* colors, size_t count);
+	void dropOldest();
+	void clear();
+
+	size_t size() const { return snapshots.size(); }
+	size_t bytes() const { return usedBytes; }
+
+	// draws all snapshots with their colors, returns the number of points
+	int draw();
+
+private:
+	void evict();
+};
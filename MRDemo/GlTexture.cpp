@@ -2,6 +2,12 @@
 #include <stb_image.h>
 
 #include "GlTexture.h"
+#include "GlExtensions.h"
+#include "MRProfiler.h"
+#include "GlTimerQueries.h"
+
+#include <cstring>
+#include <cstdint>
 
 void GlTexture::render(const rs2::video_frame& frame, const rect& rect)
 {
@@ -13,38 +19,102 @@ void GlTexture::upload(const rs2::video_frame& frame)
 {
 	if (!frame) return;
 
-	if (!gl_handle)
-		glGenTextures(1, &gl_handle);
-	GLenum err = glGetError();
-
-	auto format = frame.get_profile().format();
-	auto width = frame.get_width();
-	auto height = frame.get_height();
 	stream = frame.get_profile().stream_type();
+	upload(frame.get_data(), frame.get_width(), frame.get_height(), frame.get_stride_in_bytes(), frame.get_profile().format());
+}
 
-	glBindTexture(GL_TEXTURE_2D, gl_handle);
-
+void GlTexture::upload(const void* data, int width, int height, int strideBytes, rs2_format format)
+{
+	MR_PROFILE_ZONE("GlTexture::upload");
+	GLenum internalFormat, dataFormat;
+	int bytesPerPixel;
 	switch (format)
 	{
 	case RS2_FORMAT_RGB8:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, frame.get_data());
+		internalFormat = GL_RGB8; dataFormat = GL_RGB; bytesPerPixel = 3;
 		break;
 	case RS2_FORMAT_RGBA8:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame.get_data());
+		internalFormat = GL_RGBA8; dataFormat = GL_RGBA; bytesPerPixel = 4;
 		break;
 	case RS2_FORMAT_Y8:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, frame.get_data());
+		internalFormat = GL_RGB8; dataFormat = GL_LUMINANCE; bytesPerPixel = 1;
 		break;
 	default:
 		throw std::runtime_error("The requested format is not supported by this demo!");
 	}
 
+	if (!gl_handle || width != this->width || height != this->height || internalFormat != this->internalFormat)
+		allocate(width, height, internalFormat);
+
+	glBindTexture(GL_TEXTURE_2D, gl_handle);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// the row length is in pixels, a stride of partial pixels takes one copy per row
+	const bool wholePixels = strideBytes % bytesPerPixel == 0;
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, wholePixels ? strideBytes / bytesPerPixel : 0);
+
+	const GLvoid* pixels = data;
+	bool fromPBO = false;
+	if (usePBO && glext::hasPBO())
+	{
+		if (!pbo[0])
+			glext::glGenBuffers(PBO_COUNT, pbo);
+		// the driver may still copy from the buffers of the previous frames, take the next one
+		pboIndex = (pboIndex + 1) % PBO_COUNT;
+		const size_t size = (size_t)strideBytes * height;
+		glext::glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[pboIndex]);
+		glext::glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);	// orphaned, mapping does not wait
+		void* mapped = glext::glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		if (mapped) {
+			memcpy(mapped, data, size);
+			glext::glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			pixels = nullptr;	// offset 0 into the bound buffer
+			fromPBO = true;
+		}
+		else {
+			glext::glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+	if (wholePixels)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, dataFormat, GL_UNSIGNED_BYTE, pixels);
+	else {
+		// pixels is an offset into the buffer with a PBO bound, hence the arithmetic on integers
+		for (int y = 0; y < height; y++)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, dataFormat, GL_UNSIGNED_BYTE,
+				reinterpret_cast<const GLvoid*>(reinterpret_cast<uintptr_t>(pixels) + (uintptr_t)y * strideBytes));
+	}
+	if (fromPBO)
+		glext::glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GlTexture::allocate(int width, int height, GLenum internalFormat)
+{
+	// immutable storage can't be re-specified, it takes a new texture
+	if (gl_handle && glext::hasTexStorage()) {
+		glDeleteTextures(1, &gl_handle);
+		gl_handle = 0;
+	}
+	if (!gl_handle)
+		glGenTextures(1, &gl_handle);
+
+	glBindTexture(GL_TEXTURE_2D, gl_handle);
+	if (glext::hasTexStorage())
+		glext::glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 	glBindTexture(GL_TEXTURE_2D, 0);
+
+	this->width = width;
+	this->height = height;
+	this->internalFormat = internalFormat;
 }
 
 void GlTexture::uploadFile(char const *filename)
@@ -52,8 +122,14 @@ void GlTexture::uploadFile(char const *filename)
 	if (!filename)
 		return;
 
+	if (gl_handle && internalFormat) {
+		glDeleteTextures(1, &gl_handle);	// storage of upload(), may be immutable
+		gl_handle = 0;
+	}
 	if (!gl_handle)
 		glGenTextures(1, &gl_handle);
+	width = height = 0;
+	internalFormat = 0;
 
 	int w, h, n;
 	void* data = stbi_load(filename, &w, &h, &n, 4);
@@ -71,6 +147,7 @@ void GlTexture::uploadFile(char const *filename)
 
 void GlTexture::show(const rect& r) const
 {
+	GlTimerScope gpuTimer(EMRStage::GPU_SHOW);
 	if (!gl_handle)
 		return;
 
@@ -10,17 +10,38 @@
 ////////////////////////
 // Image display code //
 ////////////////////////
+// Frames are streamed into storage allocated once per format and resolution (immutable with OpenGL 4.2).
+// Optionally through a ring of pixel buffer objects: the driver copies from the buffer into the texture while
+// the CPU goes on, and the next frame fills the next buffer instead of waiting for that copy. Off by default,
+// it costs an extra copy where the driver has no DMA to overlap it with (see the upload timings of MRBench).
+// The texture is updated with the frame passed (no frame of latency), the color has to match the points.
 class GlTexture
 {
 	GLuint gl_handle = 0;
 	rs2_stream stream = RS2_STREAM_ANY;
 
+	// storage of gl_handle, 0 if allocated by uploadFile()
+	int width = 0;
+	int height = 0;
+	GLenum internalFormat = 0;
+
+	static const int PBO_COUNT = 3;
+	GLuint pbo[PBO_COUNT] = {};
+	int pboIndex = 0;
+	bool usePBO = false;
+
 public:
 	void render(const rs2::video_frame& frame, const rect& rect);
 	void upload(const rs2::video_frame& frame);
+	void upload(const void* data, int width, int height, int strideBytes, rs2_format format);
 	void uploadFile(char const *filename);
 	void show(const rect& r) const;
 
 	GLuint get_gl_handle() { return gl_handle; }
+	// streams through the pixel buffer objects if supported, otherwise copies synchronously (default)
+	void setPixelBuffers(bool use) { usePBO = use; }
+
+private:
+	void allocate(int width, int height, GLenum internalFormat);
 };
 
@@ -0,0 +1,93 @@
+#include "GlTimerQueries.h"
+#include "GlExtensions.h"
+
+#include <cstring>
+
+GlTimerQueries& GlTimerQueries::instance()
+{
+	static GlTimerQueries queries;
+	return queries;
+}
+
+bool GlTimerQueries::create()
+{
+	if (created)
+		return true;
+	if (!glext::hasTimerQuery())
+		return false;
+	for (Frame& frame : frames) {
+		glext::glGenQueries(STAGES * 2 * SPANS_PER_STAGE, &frame.queries[0][0]);
+		memset(frame.spans, 0, sizeof(frame.spans));
+		memset(frame.open, 0, sizeof(frame.open));
+		frame.last = 0;
+	}
+	created = true;
+	return true;
+}
+
+void GlTimerQueries::destroy()
+{
+	if (!created)
+		return;
+	for (Frame& frame : frames)
+		glext::glDeleteQueries(STAGES * 2 * SPANS_PER_STAGE, &frame.queries[0][0]);
+	created = false;
+	current = nullptr;
+}
+
+void GlTimerQueries::beginFrame(MRStageTimings& timings)
+{
+	if (!created)
+		return;
+	current = &frames[frameCount++ % FRAMES_IN_FLIGHT];
+	Frame& frame = *current;
+	if (frame.last) {
+		// the queries complete in order: when the last one is available, all of the frame are
+		GLint available = 0;
+		glext::glGetQueryObjectiv(frame.last, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			for (int s = 0; s < STAGES; s++) {
+				if (!frame.spans[s])
+					continue;
+				uint64_t nanos = 0;
+				for (int i = 0; i < frame.spans[s]; i++) {
+					uint64_t start = 0, end = 0;
+					glext::glGetQueryObjectui64v(frame.queries[s][2 * i], GL_QUERY_RESULT, &start);
+					glext::glGetQueryObjectui64v(frame.queries[s][2 * i + 1], GL_QUERY_RESULT, &end);
+					nanos += end > start ? end - start : 0;
+				}
+				timings.add((EMRStage)(FIRST_STAGE + s), nanos / 1e6);
+			}
+			completed++;
+		}
+		else {
+			skipped++;
+		}
+	}
+	memset(frame.spans, 0, sizeof(frame.spans));
+	memset(frame.open, 0, sizeof(frame.open));
+	frame.last = 0;
+}
+
+void GlTimerQueries::begin(EMRStage stage)
+{
+	const int s = (int)stage - FIRST_STAGE;
+	if (!current || s < 0 || s >= STAGES || current->open[s] || current->spans[s] >= SPANS_PER_STAGE)
+		return;
+	GLuint query = current->queries[s][2 * current->spans[s]];
+	glext::glQueryCounter(query, GL_TIMESTAMP);
+	current->open[s] = true;
+	current->last = query;
+}
+
+void GlTimerQueries::end(EMRStage stage)
+{
+	const int s = (int)stage - FIRST_STAGE;
+	if (!current || s < 0 || s >= STAGES || !current->open[s])
+		return;
+	GLuint query = current->queries[s][2 * current->spans[s] + 1];
+	glext::glQueryCounter(query, GL_TIMESTAMP);
+	current->open[s] = false;
+	current->spans[s]++;
+	current->last = query;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "GlTypes.h"
+#include "MRStageTimings.h"
+
+#include <cstdint>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////
+// Time spent by the GPU per stage of a frame                  //
+/////////////////////////////////////////////////////////////////
+// A pair of GL_TIMESTAMP queries around each GPU_ stage (GL_TIME_ELAPSED cannot nest, and the setup gizmo is
+// drawn within the scene). The queries of a frame are read back FRAMES_IN_FLIGHT frames later, when the GPU has
+// long finished them, so reading never stalls the render thread; a frame whose results are not available yet
+// by then is skipped. Spans of the same stage within a frame are summed (e.g. several GlTexture::show()).
+// One instance for the context of the render thread, begin() and end() do nothing before create().
+class GlTimerQueries
+{
+public:
+	static const int FRAMES_IN_FLIGHT = 4;
+	static const int SPANS_PER_STAGE = 4;	// per frame, further spans are not timed
+
+private:
+	static const int FIRST_STAGE = (int)EMRStage::GPU_POINTS;
+	static const int STAGES = (int)EMRStage::COUNT - FIRST_STAGE;
+
+	struct Frame
+	{
+		GLuint queries[STAGES][2 * SPANS_PER_STAGE];	// start and end timestamp per span
+		int spans[STAGES];			// completed spans
+		bool open[STAGES];			// begin() issued the start of the next span
+		GLuint last;		// the query issued last, 0..none
+	};
+
+	bool created = false;
+	Frame frames[FRAMES_IN_FLIGHT];
+	unsigned long frameCount = 0;
+	Frame* current = nullptr;
+	unsigned long completed = 0;	// frames whose results were read
+	unsigned long skipped = 0;		// frames whose results were not available in time
+
+	GlTimerQueries() = default;
+
+public:
+	static GlTimerQueries& instance();
+	GlTimerQueries(const GlTimerQueries&) = delete;
+	GlTimerQueries& operator=(const GlTimerQueries&) = delete;
+
+	bool create();	// false if the context has no timer queries (needs OpenGL 3.3 or GL_ARB_timer_query)
+	void destroy();
+	bool isCreated() const { return created; }
+
+	// starts the next frame, after adding the durations of the frame FRAMES_IN_FLIGHT frames ago to timings
+	void beginFrame(MRStageTimings& timings);
+	void begin(EMRStage stage);
+	void end(EMRStage stage);
+
+	unsigned long completedFrames() const { return completed; }
+	unsigned long skippedFrames() const { return skipped; }
+};
+
+// times its scope on the GPU
+class GlTimerScope
+{
+	EMRStage stage;
+
+public:
+	explicit GlTimerScope(EMRStage stage) : stage(stage) { GlTimerQueries::instance().begin(stage); }
+	GlTimerScope(const GlTimerScope&) = delete;
+	GlTimerScope& operator=(const GlTimerScope&) = delete;
+	~GlTimerScope() { GlTimerQueries::instance().end(stage); }
+};
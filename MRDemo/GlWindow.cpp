@@ -1,13 +1,27 @@
 #include "GlWindow.h"
+#include "GlExtensions.h"
+#include "MRProfiler.h"
 
-GlWindow::GlWindow(int width, int height, const char* title)
-: _width(width), _height(height)
+#include <iostream>
+#include <chrono>
+
+GlWindow::GlWindow(int width, int height, const char* title, bool headless)
+: _width(width), _height(height), headless(headless)
 {
 	glfwInit();
+	if (headless)
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 	win = glfwCreateWindow(width, height, title, nullptr, nullptr);
 	if (!win)
 		throw std::runtime_error("Could not open OpenGL window, please check your graphic drivers or use the textual SDK tools");
 	glfwMakeContextCurrent(win);
+	glfwSwapInterval(headless ? 0 : 1);	// render at the display refresh, independent of the camera frame-rate
+	glext::init();
+	if (headless) {
+		if (!offscreen.create(width, height))
+			throw std::runtime_error("Could not create the offscreen framebuffer, headless rendering needs OpenGL 3.0 or GL_ARB_framebuffer_object");
+		offscreen.bind();	// stays bound, everything is rendered into it
+	}
 
 	glfwSetWindowUserPointer(win, this);
 	glfwSetMouseButtonCallback(win, [](GLFWwindow * w, int button, int action, int mods)
@@ -49,12 +63,34 @@ GlWindow::~GlWindow()
 GlWindow::operator bool()
 {
 	glPopMatrix();
-	glfwSwapBuffers(win);
+	if (rendering)
+		frameCount++;	// the first call is before any frame
+	rendering = true;
+	auto swapStart = std::chrono::steady_clock::now();
+	{
+		MR_PROFILE_ZONE("GlWindow::swap");
+		if (headless) {
+			// the frame is complete in the framebuffer, there is nothing to show
+			if (dumpEvery > 0 && frameCount > 0 && frameCount % dumpEvery == 0) {
+				std::string number = std::to_string(frameCount);
+				std::string path = dumpDirectory + "/frame-" + std::string(number.size() < 6 ? 6 - number.size() : 0, '0') + number + ".ppm";
+				if (!offscreen.save(path))
+					std::cerr << "could not save " << path << std::endl;
+			}
+			glFinish();		// the frame rate is the one of the rendering, not of the submission
+		}
+		else {
+			glfwSwapBuffers(win);
+		}
+	}
+	swapEnd = std::chrono::steady_clock::now();
+	swapMillis = std::chrono::duration<double, std::milli>(swapEnd - swapStart).count();
 
 	auto res = !glfwWindowShouldClose(win);
 
 	glfwPollEvents();
-	glfwGetFramebufferSize(win, &_width, &_height);
+	if (!headless)
+		glfwGetFramebufferSize(win, &_width, &_height);
 
 	// Clear the framebuffer
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -62,12 +98,19 @@ GlWindow::operator bool()
 
 	// Draw the images
 	glPushMatrix();
-	glfwGetWindowSize(win, &_width, &_height);
+	if (!headless)
+		glfwGetWindowSize(win, &_width, &_height);
 	glOrtho(0, _width, _height, 0, -1, +1);
 
 	return res;
 }
 
+void GlWindow::dumpFrames(const std::string& directory, int every)
+{
+	dumpDirectory = directory;
+	dumpEvery = headless ? every : 0;
+}
+
 void GlWindow::show(rs2::frame frame)
 {
 	show(frame, { 0, 0, (float)_width, (float)_height });
@@ -8,6 +8,10 @@
 #include "GlTypes.h"
 #include "GlTexture.h"
 #include "GlImuDrawer.h"
+#include "GlFramebuffer.h"
+
+#include <string>
+#include <chrono>
 
 // Struct for managing rotation of pointcloud view
 struct glfw_state {
@@ -26,6 +30,10 @@ struct glfw_state {
 ////////////////////////////////////
 // Window for displaying OpenGL   //
 ////////////////////////////////////
+// A headless window stays hidden and renders into a framebuffer object of the given size instead,
+// without waiting for the display; every Nth frame can be saved (see dumpFrames()).
+// It is still a window of the desktop: GLFW 3.1 has no EGL or OSMesa context, so there is no surfaceless one.
+// Without a GPU, Mesa's software opengl32.dll next to the executable provides the context.
 
 class GlWindow
 {
@@ -35,12 +43,20 @@ public:
 	std::function<void(double, double)> on_mouse_move = [](double, double) {};
 	std::function<void(int)>            on_key_release = [](int) {};
 
-	GlWindow(int width, int height, const char* title);
+	GlWindow(int width, int height, const char* title, bool headless = false);
 
 	float width() const { return float(_width); }
 	float height() const { return float(_height); }
 
 	operator bool();
+
+	bool isHeadless() const { return headless; }
+	// saves every Nth rendered frame as <directory>/frame-<number>.ppm, 0..none
+	void dumpFrames(const std::string& directory, int every);
+	unsigned long renderedFrames() const { return frameCount; }
+	double lastSwapMillis() const { return swapMillis; }	// buffer swap (incl. the wait for vsync) or glFinish() when headless
+	// the last frame is on display (as far as the driver tells), the end of the capture-to-display latency
+	std::chrono::steady_clock::time_point lastSwapEnd() const { return swapEnd; }
 	
 	~GlWindow();
 
@@ -55,6 +71,14 @@ private:
 	std::map<int, GlTexture> _textures;
 	std::map<int, GlImuDrawer> _imus;
 	int _width, _height;
+	bool headless;
+	GlFramebuffer offscreen;	// render target of the headless window
+	std::string dumpDirectory;
+	int dumpEvery = 0;
+	unsigned long frameCount = 0;	// frames completed, counted by operator bool()
+	bool rendering = false;			// operator bool() was called before, a frame is complete
+	double swapMillis = 0.0;
+	std::chrono::steady_clock::time_point swapEnd;
 
 	void render_video_frame(const rs2::video_frame& f, const rect& r);
 	void render_motoin_frame(const rs2::motion_frame& f, const rect& r);
@@ -1,10 +1,15 @@
 #include <imgui/imgui.h>
 #include "imgui/imgui_impl_glfw.h"
 
+#ifdef _WIN32
 #define NOMINMAX
-#include <Windows.h>			// GetTickCount()
+#include <Windows.h>			// GetModuleFileName()
+#else
+#include <unistd.h>				// readlink()
+#endif
 
 #include "MRDemo.h"
+#include "GlTimerQueries.h"
 
 #include <string>
 #include <sstream>
@@ -13,91 +18,164 @@
 #include <iomanip>
 #include <cmath>
 #include <map>
+#include <ctime>				// std::time()
 #include <filesystem>			// std::filesystem::current_path()
 
 
-MRDemo::MRDemo() : GlWindow(1280, 720, "Multiple-Reality Demo")
+MRDemo::MRDemo(const MRDemoOptions& options) : GlWindow(1280, 720, "Multiple-Reality Demo", options.headless)
+, options(options)
+, governor(settings)
 , sceneSetup(settings)
 , sceneSnap(settings)
 , sceneIBC(settings)
 , sceneTron(settings)
 , sceneStartrek(settings)
 {
+	MR_PROFILE_THREAD("render");
+	if (!GlTimerQueries::instance().create())
+		std::cout << "no GPU timings, timer queries need OpenGL 3.3 or GL_ARB_timer_query" << std::endl;
 	ImGui_ImplGlfw_Init(*this, false);      // ImGui library intializition
+	pipeline.setTimings(&timings);
+	pipeline.setFrameQueueSize(options.frameQueueSize);
 	// register callbacks to allow manipulation of the pointcloud
 	glRegisterCallbacks();
 
-	// Start streaming with default recommended configuration
-    //Calling pipeline's start() without any additional parameters will start the first device
-	// with its default streams.
-	//The start function returns the pipeline profile which the pipeline used to start the device
-	profile = pipe.start();
+	// Start streaming with default recommended configuration, capturing and processing in own threads
+	if (options.synthetic) {
+		MRSyntheticOptions synthetic = options.syntheticOptions;
+		synthetic.range = { settings.scanMinZ, settings.scanMaxZ };
+		pipeline.startSynthetic(synthetic);
+	}
+	else if (options.playbackFile.empty())
+		profile = pipeline.start();
+	else {
+		profile = pipeline.startPlayback(options.playbackFile, options.realTime, options.loops);
+		playbackStart = std::chrono::steady_clock::now();
+	}
 
 	pActScene = &sceneSetup;
+	settings.random_seed = (unsigned int)std::time(nullptr);	// use current time as seed for the effects
 
-	showSplashScreen = true;
+	showSplashScreen = !options.headless;	// nobody to click it away
 
 	rotation_yaw = 0;
 	rotation_yaw_delta = 0;
 	rotation_max_angle = 15.0;
 	rotation_velocity = 0.5f;
-	rotation_last_tick = GetTickCount();
+	rotation_last_tick = std::chrono::steady_clock::now();
 
+#ifdef _WIN32
 	char result[MAX_PATH];
 	currentPath = std::string(result, GetModuleFileName(NULL, result, MAX_PATH));
+#else
+	char result[4096];
+	ssize_t length = readlink("/proc/self/exe", result, sizeof(result));
+	currentPath = std::string(result, length > 0 ? (size_t)length : 0);
+#endif
 	std::cout << "Executed file is " << currentPath << std::endl;
 	currentPath = currentPath.substr(0, currentPath.find_last_of("/\\"));
-	std::string s =  currentPath + "\\SplashScreen.png";
+	std::string s =  currentPath + "/SplashScreen.png";
 	std::cout << "Loading splash image from " << s << std::endl;
 	splashScreen.uploadFile(s.c_str());
+	sceneSnap.setDirectory(currentPath + "/snapshots");
+	if (options.headless && options.dumpEvery > 0) {
+		createSnapshotDirectory(options.dumpDirectory);
+		dumpFrames(options.dumpDirectory, options.dumpEvery);
+	}
 
-	tick = GetTickCount();
-	fps = 0.0f;
+	frameStart = renderStart = fpsStart = std::chrono::steady_clock::now();
 }
 
 
 MRDemo::~MRDemo()
 {
 	//stbi_image_free(splashScreen);
+	GlTimerQueries::instance().destroy();	// before the context
 }
 
 
 bool MRDemo::run()
 {
-	// Wait for the next set of frames from the camera
-	auto frames = pipe.wait_for_frames();
-	// rs2::pipeline::wait_for_frames() can replace the device it uses in case of device error or disconnection.
-
-	rs2::depth_frame depth = frames.get_depth_frame();
-	if ( !depth )
-		return true;		//If one of them is unavailable, continue iteration
-
-	if (settings.density > 1) {
-		depth = dec_filter.process(depth);
+	MR_PROFILE_FRAME();
+	MR_PROFILE_ZONE("MRDemo::run");
+	GlTimerQueries::instance().beginFrame(timings);	// the GPU times of some frames ago
+	auto now = std::chrono::steady_clock::now();
+	double frameMillis = std::chrono::duration<double, std::milli>(now - frameStart).count();
+	frameStart = now;
+	if (renderedFrames() > 0)
+		timings.add(EMRStage::SWAP, lastSwapMillis());	// of the previous frame
+	if (latencyPending) {
+		latency.shown(frame.tag, lastSwapEnd());
+		latencyPending = false;
+	}
+	if (options.frames > 0 && renderedFrames() >= (unsigned long)options.frames) {
+		// all frames are rendered, report the throughput for comparisons between builds and machines
+		double seconds = std::chrono::duration<double>(now - renderStart).count();
+		std::cout << (isHeadless() ? "headless: " : "") << options.frames << " frames rendered in " << std::fixed << std::setprecision(2)
+			<< seconds << "s, " << options.frames / seconds << " fps render, " << cloud / seconds << " fps camera" << std::endl;
+		std::cout << latency.statusText() << ", " << pipeline.lostFrames() << " lost before capture" << std::endl;
+		finished = true;
+		return true;
 	}
 
-	// Generate the pointcloud and texture mappings
-	points = pc.calculate(depth);
-	rs2::video_frame color = frames.get_color_frame();
-	// For cameras that don't have RGB sensor, we'll map the pointcloud to infrared instead of color
-	if (!color || !settings.colored )
-		color = frames.get_infrared_frame();
-	// Tell pointcloud object to map to this color frame
-	pc.map_to(color);
-	// Upload the color frame to OpenGL
-	app_state.tex.upload(color);
-
-
+	// the processing thread applies the settings to the next frames
+	pipeline.setDensity(settings.density);
+	pipeline.setColored(settings.colored);
+	// plain scenes can build their points from the raw depth on the GPU, then the CPU skips the pointcloud
+	bool gpuCloud = settings.gpu_deprojection && pActScene->isPlain() && depthCloud.isSupported();
+	pipeline.setPointcloud(!gpuCloud);
+	pipeline.setSimdDeprojection(settings.simd_deprojection);
+	pipeline.setScanRange({ settings.scanMinZ, settings.scanMaxZ });
+	pipeline.setHistogram(settings.show_histogram && pActScene->type() == EMRSceneType::SETUP);
+
+	// Take the latest frame processed by the pipeline (decimation, pointcloud and texture mapping), without waiting:
+	// the window renders at the display refresh, in between the last cloud is drawn again
+	if (pipeline.poll(frame)) {
+		cloud++;
+		latencyPending = true;
+		// Upload the color frame to OpenGL
+		MRStageTimer timer(&timings, EMRStage::UPLOAD);
+		app_state.tex.upload(frame.color);
+		sceneSnap.setCamera(frame.depthIntrinsics);
+		sceneSnap.setColorFrame(frame.color);
+	}
+	else if (pipeline.isPlayback() && pipeline.hasEnded()) {
+		// all passes are shown, report the throughput for comparisons between builds and machines
+		double seconds = std::chrono::duration<double>(now - playbackStart).count();
+		std::cout << "playback: " << pipeline.completedPasses() << " passes, " << pipeline.processed() << " framesets processed in "
+			<< std::fixed << std::setprecision(2) << seconds << "s, " << pipeline.processed() / seconds << " fps processed, "
+			<< cloud / seconds << " fps shown" << std::endl;
+		std::cout << latency.statusText() << std::endl;
+		finished = true;
+		return true;
+	}
+	if (!frame.depth)
+		return true;		//If there was none yet, continue iteration
+	PointCloud points = frame.pointCloud();
+	rs2::depth_frame depth = frame.depth;
+	rs2::video_frame color = frame.color;
+
+	// right after switching the path, the frames still in the pipeline were processed without points
+	if (!frame.hasPoints())
+		gpuCloud = true;
+	if (gpuCloud && depthCloudUploaded != cloud) {
+		MRStageTimer timer(&timings, EMRStage::UPLOAD);
+		depthCloud.setCamera(frame.depthScale, frame.depthIntrinsics, frame.colorIntrinsics, frame.depthToColor);
+		depthCloud.upload(depth);
+		depthCloudUploaded = cloud;
+	}
 
 	// Draw the pointcloud
-	int pointCount = 0;
-	if (points) {
-		// Handles all the OpenGL calls needed to display the point cloud
-		glPrepareScreen();
-		pActScene->preRenderPointCloud();
-		pointCount = pActScene->renderPointCloud(points);
-		glCleanupScreen();
-	}
+	// Handles all the OpenGL calls needed to display the point cloud
+	glPrepareScreen();
+	MRStageTimer preRenderTimer(&timings, EMRStage::PRE_RENDER);
+	pActScene->preRenderPointCloud();
+	preRenderTimer.stop();
+	MRStageTimer renderTimer(&timings, EMRStage::RENDER);
+	int pointCount = gpuCloud ? pActScene->renderDepthCloud(depthCloud, depth, cloud)
+		: pActScene->renderPointCloud(points, cloud);
+	glCleanupScreen();
+	renderTimer.stop();
 
 	if (showSplashScreen) {
 		splashScreen.show({ (width() - 1024.f) / 2.f, (height() - 564.f) / 2.f , 1024.f, 564.f });
@@ -105,19 +183,44 @@ bool MRDemo::run()
 
 	// Using ImGui library to provide a GUI
 	// Taking dimensions of the window for rendering purposes
+	MRStageTimer imguiTimer(&timings, EMRStage::IMGUI);
 	ImGui_ImplGlfw_NewFrame(1);
 
-	// render the frame-rate
-	long tick2 = GetTickCount();
-	float fps = 1000.f / (tick2 - tick);
-	tick = tick2;
-	std::string status = std::to_string(pointCount / 1000) + "k points, "
-		+ std::to_string((int)fps) + "." + std::to_string(((int)(fps*10.f)) % 10) + " fps";
-	uiDrawText({ 30, height() - 30, 200, 30 }, status);
+	// render the frame-rates, averaged over half a second (see the timings overlay for single frames)
+	fpsFrames++;
+	double fpsMillis = std::chrono::duration<double, std::milli>(now - fpsStart).count();
+	if (fpsMillis >= 500.0) {
+		renderFps = (float)(fpsFrames * 1000.0 / fpsMillis);
+		cameraFps = (float)((cloud - fpsCloud) * 1000.0 / fpsMillis);
+		fpsStart = now;
+		fpsFrames = 0;
+		fpsCloud = cloud;
+	}
+	// the GPU path submits every pixel of the depth image, its shader drops those outside of the scan range
+	std::string status = std::to_string(pointCount / 1000) + (gpuCloud ? "k pixels, " : "k points, ")
+		+ std::to_string((int)renderFps) + "." + std::to_string(((int)(renderFps*10.f)) % 10) + " fps render, "
+		+ std::to_string((int)cameraFps) + "." + std::to_string(((int)(cameraFps*10.f)) % 10) + " fps camera"
+		+ (gpuCloud ? " (GPU)" : frame.deprojected ? " (SIMD, " : " (rs2, ")
+		+ (gpuCloud ? "" : settings.use_vbo ? "VBO)" : "immediate)");
+	status += "\n" + pipeline.statusText();
+	status += "\n" + latency.statusText();
+	status += "\n" + governor.statusText();
+	uiDrawText({ 30, height() - 88, 760, 88 }, status);
+	if (showTimings)
+		uiDrawTimings({ width() - 450, 30, 420, 430 });
 
 	pActScene->renderImgUI(width(), height(), depth, color);
 
-	ImGui::Render();
+	{
+		MR_PROFILE_ZONE("ImGui::Render");
+		GlTimerScope gpuTimer(EMRStage::GPU_IMGUI);
+		ImGui::Render();
+	}
+	imguiTimer.stop();
+
+	// the time spent up to here (without the wait for vsync in the buffer swap) tells the governor how much headroom is left
+	double workMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+	governor.update(frameMillis, workMillis, pActScene->type() == EMRSceneType::SETUP);
 
 	return true;
 }
@@ -144,8 +247,8 @@ void MRDemo::glPrepareScreen()
 	// implement animated rotation
 	if( settings.auto_rotation )
 	{
-		unsigned int rotation_curr_tick = GetTickCount();
-		if (rotation_curr_tick - rotation_last_tick > 40) {
+		auto rotation_curr_tick = std::chrono::steady_clock::now();
+		if (rotation_curr_tick - rotation_last_tick > std::chrono::milliseconds(40)) {
 			if (fabs(rotation_yaw_delta) > rotation_max_angle)
 				rotation_velocity = -rotation_velocity;
 			rotation_yaw_delta += rotation_velocity;
@@ -155,7 +258,7 @@ void MRDemo::glPrepareScreen()
 	glRotated(app_state.yaw + rotation_yaw_delta, 0, 1, 0);
 	glTranslatef(0, 0, -0.5f);
 
-	glPointSize(width() / 640);
+	glPointSize(width() / 640 * settings.point_size);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, app_state.tex.get_gl_handle());
@@ -221,6 +324,7 @@ void MRDemo::glRegisterCallbacks()
 			rotation_yaw = 0;
 			rotation_yaw_delta = 0;
 			settings.reset();
+			governor.reset();
 			if (pActScene->type() != EMRSceneType::SETUP) {
 				pActScene = &sceneSnap;
 			}
@@ -229,15 +333,15 @@ void MRDemo::glRegisterCallbacks()
 		else if (key == GLFW_KEY_SLASH /* DE:[-] */ || key == GLFW_KEY_KP_SUBTRACT) {
 			if (settings.density < 8) {
 				settings.density++;
-				dec_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, settings.density);
 			}
+			governor.reset();	// the user's choice is the new best quality
 			std::cout << "density=" << settings.density << " //incremented" << std::endl;
 		}
 		else if (key == GLFW_KEY_RIGHT_BRACKET /* DE:[+] */ || key == GLFW_KEY_KP_ADD) {
 			if (settings.density > 1) {
 				settings.density--;
-				dec_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, settings.density);
 			}
+			governor.reset();
 			std::cout << "density=" << settings.density << " //decremented" << std::endl;
 		}
 
@@ -295,13 +399,61 @@ void MRDemo::glRegisterCallbacks()
 			MRSceneIBC* pSceneIBC = dynamic_cast<MRSceneIBC*>(pActScene);
 			pSceneIBC->decWaterYPosition();
 		}
+		else if (key == GLFW_KEY_X) {
+			sceneSnap.clearSnapshots();
+		}
+		else if (key == GLFW_KEY_PAGE_UP || key == GLFW_KEY_PAGE_DOWN) {
+			// browse the stored snapshots, shown by the snapshot scene
+			if (pActScene->type() != EMRSceneType::SETUP)
+				pActScene = &sceneSnap;
+			sceneSnap.browseSnapshots(key == GLFW_KEY_PAGE_UP ? -1 : 1);
+		}
 		else if (key == GLFW_KEY_R) {
 			settings.auto_rotation = !settings.auto_rotation;
 		}
+		else if (key == GLFW_KEY_V) {
+			settings.use_vbo = !settings.use_vbo;
+			std::cout << "use_vbo=" << settings.use_vbo << " //toggled" << std::endl;
+		}
+		else if (key == GLFW_KEY_D) {
+			settings.gpu_deprojection = !settings.gpu_deprojection;
+			std::cout << "gpu_deprojection=" << settings.gpu_deprojection << " //toggled"
+				<< (depthCloud.isSupported() ? "" : ", not supported by the OpenGL driver") << std::endl;
+		}
+		else if (key == GLFW_KEY_C) {
+			settings.simd_deprojection = !settings.simd_deprojection;
+			std::cout << "simd_deprojection=" << settings.simd_deprojection << " //toggled" << std::endl;
+		}
+		else if (key == GLFW_KEY_G) {
+			settings.governor = !settings.governor;
+			if (settings.governor)
+				governor.reset();	// aims for the quality of now
+			else
+				governor.restore();
+			std::cout << "governor=" << settings.governor << " //toggled" << std::endl;
+		}
+		else if (key == GLFW_KEY_F) {
+			settings.target_fps = (settings.target_fps == 30) ? 60 : 30;
+			std::cout << "target_fps=" << settings.target_fps << " //toggled" << std::endl;
+		}
+		else if (key == GLFW_KEY_T) {
+			showTimings = !showTimings;
+			std::cout << "showTimings=" << showTimings << " //toggled" << std::endl;
+		}
+		else if (key == GLFW_KEY_P) {
+			writeTimings(currentPath + "/timings.csv");
+		}
+		else if (key == GLFW_KEY_Z) {
+			writeTrace(currentPath + "/trace.json");
+		}
+		else if (key == GLFW_KEY_L) {
+			writeLatency(currentPath + "/latency.csv");
+		}
 
 		else if (key == GLFW_KEY_ESCAPE)
 		{
-			exit(EXIT_SUCCESS);
+			// ends the loop of main(), which writes the requested files and destroys the app (pending snapshots are saved)
+			glfwSetWindowShouldClose(*this, GL_TRUE);
 		}
 		else if (key == GLFW_KEY_BACKSPACE)
 		{
@@ -332,3 +484,83 @@ void MRDemo::uiDrawText(rect location, std::string& caption)
 	ImGui::End();
 }
 
+void MRDemo::uiDrawTimings(rect location)
+{
+	static const int flags = ImGuiWindowFlags_NoCollapse
+		| ImGuiWindowFlags_NoScrollbar
+		| ImGuiWindowFlags_NoSavedSettings
+		| ImGuiWindowFlags_NoResize
+		| ImGuiWindowFlags_NoMove;
+
+	ImGui::SetNextWindowPos({ location.x, location.y });
+	ImGui::SetNextWindowSize({ location.w, location.h });
+
+	ImGui::Begin("Stage timings (ms)", nullptr, flags);
+	ImGui::Columns(5, "timings", false);
+	ImGui::SetColumnOffset(1, 170);
+	for (const char* header : { "stage", "p50", "p95", "p99", "max" }) {
+		ImGui::Text("%s", header);
+		ImGui::NextColumn();
+	}
+	for (int s = 0; s < (int)EMRStage::COUNT; s++) {
+		MRStageTimings::Summary summary = timings.summary((EMRStage)s);
+		if (summary.samples == 0)
+			continue;	// e.g. decimation at density 1
+		ImGui::Text("%s", MRStageTimings::name((EMRStage)s));
+		ImGui::NextColumn();
+		for (double millis : { summary.p50, summary.p95, summary.p99, summary.max }) {
+			ImGui::Text("%.2f", millis);
+			ImGui::NextColumn();
+		}
+	}
+	// capture-to-display latency, resolved to the bins of its histogram
+	for (int l = 0; l < (int)EMRLatency::COUNT; l++) {
+		MRLatency::Summary summary = latency.summary((EMRLatency)l);
+		if (summary.frames == 0)
+			continue;	// e.g. no timestamps on the system clock
+		ImGui::Text("%s", MRLatency::name((EMRLatency)l));
+		ImGui::NextColumn();
+		for (double millis : { summary.p50, summary.p95, summary.p99, summary.max }) {
+			ImGui::Text("%.0f", millis);
+			ImGui::NextColumn();
+		}
+	}
+	ImGui::Columns(1);
+
+	static const int PLOT_BINS = 100 / MRLatency::BIN_MILLIS;	// up to 100 ms
+	EMRLatency plotted = latency.summary(EMRLatency::CAPTURE).frames > 0 ? EMRLatency::CAPTURE : EMRLatency::ARRIVAL;
+	float bins[PLOT_BINS];
+	for (int bin = 0; bin < PLOT_BINS; bin++)
+		bins[bin] = (float)latency.bins(plotted)[bin];
+	std::string label = std::string(MRLatency::name(plotted)) + ", 0-100 ms";
+	ImGui::PlotHistogram("##latency", bins, PLOT_BINS, 0, label.c_str(), 0.0f, FLT_MAX, { location.w - 20, 80 });
+	ImGui::End();
+}
+
+bool MRDemo::writeTrace(const std::string& path) const
+{
+#ifdef MR_PROFILER
+	bool written = MRProfiler::instance().writeChromeTrace(path);
+	std::cout << (written ? "trace written to " : "could not write the trace to ") << path
+		<< " (open it in chrome://tracing or ui.perfetto.dev)" << std::endl;
+	return written;
+#else
+	std::cout << "no trace, MRDemo is built without MR_PROFILER" << std::endl;
+	return false;
+#endif
+}
+
+bool MRDemo::writeLatency(const std::string& path) const
+{
+	bool written = latency.writeCsv(path);
+	std::cout << (written ? "latency histogram written to " : "could not write the latency histogram to ") << path
+		<< " (" << latency.statusText() << ")" << std::endl;
+	return written;
+}
+
+bool MRDemo::writeTimings(const std::string& path) const
+{
+	bool written = timings.writeCsv(path);
+	std::cout << (written ? "timings written to " : "could not write the timings to ") << path << std::endl;
+	return written;
+}
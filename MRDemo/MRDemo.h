@@ -9,6 +9,32 @@
 #include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
 
 #include "MRScene.h"
+#include "MRFramePipeline.h"
+#include "MRGovernor.h"
+#include "MRStageTimings.h"
+#include "MRLatency.h"
+#include "MRProfiler.h"
+
+#include <chrono>
+#include <string>
+
+// command line of MRDemo
+struct MRDemoOptions
+{
+	std::string playbackFile;	// recording (.bag) to replay instead of the camera, empty..camera
+	bool realTime = true;		// replay at the recorded rate, otherwise as fast as the frames are processed
+	int loops = 0;				// passes through the recording before the app exits, 0..endless
+	bool synthetic = false;		// procedural frames instead of the camera
+	MRSyntheticOptions syntheticOptions;	// the scan range is taken from the settings
+	bool headless = false;		// renders offscreen, without showing a window (see GlWindow)
+	int frames = 0;				// frames rendered before the app exits, 0..endless
+	int dumpEvery = 0;			// saves every Nth frame of the headless window, 0..none
+	std::string dumpDirectory = "frames";
+	std::string timingsFile;	// CSV with the percentiles per stage, written at exit, empty..none
+	std::string traceFile;		// zones of the profiler (chrome://tracing, Perfetto), written at exit, empty..none
+	std::string latencyFile;	// CSV with the histogram of the capture-to-display latency, written at exit, empty..none
+	int frameQueueSize = 0;		// frames librealsense holds per stream, 0..its default
+};
 
 class MRDemo : public GlWindow
 {
@@ -16,13 +42,23 @@ private:
 	glfw_state app_state;
 	std::string currentPath;
 
-	rs2::decimation_filter dec_filter;	// to reduce the density
-	rs2::pointcloud pc;	// Pointcloud object, for calculating pointclouds and texture mappings
-	rs2::points points;	// We want the points object to be persistent so we can display the last cloud when a frame drops
-	rs2::pipeline pipe;	// RealSense pipeline, encapsulating the actual device and sensors
+	MRStageTimings timings;			// durations per stage of all threads, before the pipeline timing into it
+	MRFramePipeline pipeline;		// capture and processing threads
+	MRFramePipeline::Frame frame;	// We want the frame to be persistent so we can display the last cloud when a frame drops
+	unsigned long cloud = 0;		// serial of the cloud in frame, counts the new frames
+	MRLatency latency;				// from the capture of the frames to their first buffer swap
+	bool latencyPending = false;	// frame is new, its latency ends with the next swap
+	GlDepthCloud depthCloud;		// points deprojected on the GPU
+	unsigned long depthCloudUploaded = 0;	// serial of the cloud uploaded to depthCloud
 	rs2::pipeline_profile profile;
+	MRDemoOptions options;
+	std::chrono::steady_clock::time_point playbackStart;
+	bool finished = false;			// all passes of the recording or all frames are shown
+	std::chrono::steady_clock::time_point renderStart;
 
 	MRSettings settings;
+	MRGovernor governor;			// adapts the settings to the measured frame times
+	std::chrono::steady_clock::time_point frameStart;
 	MRSceneSetup sceneSetup;
 	MRSceneSnapshot sceneSnap;
 	MRSceneIBC sceneIBC;
@@ -37,10 +73,14 @@ private:
 	double rotation_yaw_delta;
 	double rotation_max_angle;
 	double rotation_velocity;
-	unsigned int rotation_last_tick;
+	std::chrono::steady_clock::time_point rotation_last_tick;
 
-	long tick = 0;		// measure the frames-per-second
-	float fps = 0.0f;	// stores the last calculated fps
+	std::chrono::steady_clock::time_point fpsStart;	// start of the interval to measure the frames-per-second
+	int fpsFrames = 0;			// frames rendered within the interval
+	unsigned long fpsCloud = 0;	// first cloud of the interval
+	float renderFps = 0.0f;		// stores the last calculated fps of the display
+	float cameraFps = 0.0f;		// and of the new pointclouds
+	bool showTimings = false;	// overlay with the percentiles per stage
 
 private:
 	// Helper functions
@@ -52,11 +92,16 @@ private:
 
 	// ImGUI functions
 	void uiDrawText(rect location, std::string& caption);
+	void uiDrawTimings(rect location);
 
 public:
-	MRDemo();
+	MRDemo(const MRDemoOptions& options = MRDemoOptions());
 	~MRDemo();
 
 	bool run();
+	bool isFinished() const { return finished; }
+	bool writeTimings(const std::string& path) const;
+	bool writeTrace(const std::string& path) const;
+	bool writeLatency(const std::string& path) const;
 };
 
@@ -0,0 +1,159 @@
+#include "MRDeprojector.h"
+
+#include <librealsense2/rsutil.h>
+
+#include <cstring>
+#include <omp.h>
+
+const size_t MRDeprojector::MAX_TABLES = 8;
+
+
+PointCloud MRDeprojector::Points::cloud() const
+{
+	PointCloud points(vertices.data(), tex_coords.data(), count);
+	points.clipped = clipped;
+	points.range = range;
+	points.histogram = histogram.empty() ? nullptr : histogram.data();
+	return points;
+}
+
+
+std::shared_ptr<MRDeprojector::Points> MRDeprojector::process(const rs2::depth_frame& depth, float depthScale, const ColorMapping* mapping,
+	const ScanRange* range, bool histogram)
+{
+	if (!depth || depth.get_profile().format() != RS2_FORMAT_Z16)
+		return nullptr;
+	rs2_intrinsics intrinsics = depth.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+	const size_t pixels = (size_t)intrinsics.width * intrinsics.height;
+	auto points = acquire(pixels);
+	const uint16_t* data = reinterpret_cast<const uint16_t*>(depth.get_data());
+	points->histogram.resize(histogram ? DEPTH_HISTOGRAM_BINS : 0);
+	points->clipped = (range != nullptr);
+	points->range = range ? *range : ScanRange{};
+	if (range) {
+		size_t count = deprojectClipped(data, depth.get_stride_in_bytes(), intrinsics, depthScale, *range, mapping,
+			points->vertices.data(), points->tex_coords.data(), histogram ? points->histogram.data() : nullptr);
+		points->count = count;
+	}
+	else {
+		deproject(data, depth.get_stride_in_bytes(), intrinsics, depthScale, mapping, points->vertices.data(), points->tex_coords.data());
+		points->count = pixels;
+		if (histogram)
+			scanDepth(data, depth.get_stride_in_bytes(), intrinsics.width, intrinsics.height, depthScale, ScanRange{},
+				nullptr, points->histogram.data(), scanScratch);
+	}
+	if (!mapping)
+		memset(points->tex_coords.data(), 0, points->count * sizeof(rs2::texture_coordinate));
+	return points;
+}
+
+void MRDeprojector::deproject(const uint16_t* depth, int strideBytes, const rs2_intrinsics& intrinsics, float depthScale,
+	const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords,
+	int threads, ESimdLevel level)
+{
+	const RayTable& table = rays(intrinsics);
+	const float* rayX = table.x.data();
+	const float* rayY = table.y.data();
+	const int width = intrinsics.width;
+	const int height = intrinsics.height;
+
+	const int BAND_ROWS = 8;	// rows per task, a few thousand points
+	const int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+	#pragma omp parallel for num_threads(threads) schedule(static)
+	for (int b = 0; b < bands; b++)
+	{
+		int row0 = b * BAND_ROWS;
+		int row1 = (row0 + BAND_ROWS < height) ? row0 + BAND_ROWS : height;
+		deprojectRows(depth, strideBytes, width, row0, row1, depthScale, rayX, rayY, mapping, vertices, tex_coords, level);
+	}
+}
+
+size_t MRDeprojector::deprojectClipped(const uint16_t* depth, int strideBytes, const rs2_intrinsics& intrinsics, float depthScale,
+	ScanRange range, const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords,
+	int* histogram, int threads, ESimdLevel level)
+{
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+	const size_t pixels = (size_t)intrinsics.width * intrinsics.height;
+	if (indices.size() < pixels)
+		indices.resize(pixels);
+	const size_t count = scanDepth(depth, strideBytes, intrinsics.width, intrinsics.height, depthScale, range,
+		indices.data(), histogram, scanScratch, threads);
+
+	const RayTable& table = rays(intrinsics);
+	const float* rayX = table.x.data();
+	const float* rayY = table.y.data();
+	const uint32_t* selected = indices.data();
+	const size_t CHUNK_SIZE = 8192;		// points per task
+	const int chunks = (int)((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	#pragma omp parallel for num_threads(threads) schedule(static)
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t start = c * CHUNK_SIZE;
+		size_t n = (c == chunks - 1) ? count - start : CHUNK_SIZE;
+		deprojectIndexed(depth, strideBytes, intrinsics.width, selected + start, n, depthScale, rayX, rayY, mapping,
+			vertices + start, mapping ? tex_coords + start : nullptr, level);
+	}
+	return count;
+}
+
+const MRDeprojector::RayTable& MRDeprojector::rays(const rs2_intrinsics& intrinsics)
+{
+	for (auto it = tables.begin(); it != tables.end(); ++it)
+	{
+		if (memcmp(&it->intrinsics, &intrinsics, sizeof(rs2_intrinsics)) == 0) {
+			tables.splice(tables.begin(), tables, it);
+			return tables.front();
+		}
+	}
+
+	// the same per-pixel operations as rs2::pointcloud, at a depth of 1 m
+	RayTable table;
+	table.intrinsics = intrinsics;
+	const size_t count = (size_t)intrinsics.width * intrinsics.height;
+	table.x.resize(count);
+	table.y.resize(count);
+	for (int y = 0, i = 0; y < intrinsics.height; y++) {
+		for (int x = 0; x < intrinsics.width; x++, i++) {
+			const float pixel[] = { (float)x, (float)y };
+			float point[3];
+			rs2_deproject_pixel_to_point(point, &intrinsics, pixel, 1.f);
+			table.x[i] = point[0];
+			table.y[i] = point[1];
+		}
+	}
+	tables.push_front(std::move(table));
+	if (tables.size() > MAX_TABLES)
+		tables.pop_back();
+	return tables.front();
+}
+
+std::shared_ptr<MRDeprojector::Points> MRDeprojector::acquire(size_t count)
+{
+	std::unique_ptr<Points> reused;
+	{
+		std::lock_guard<std::mutex> lock(freeList->mutex);
+		if (!freeList->points.empty()) {
+			reused = std::move(freeList->points.back());
+			freeList->points.pop_back();
+		}
+	}
+	if (!reused)
+		reused.reset(new Points);
+
+	std::weak_ptr<FreeList> weakFreeList = freeList;
+	std::shared_ptr<Points> points(reused.release(), [weakFreeList](Points* released) {
+		std::unique_ptr<Points> owned(released);
+		if (std::shared_ptr<FreeList> list = weakFreeList.lock()) {
+			std::lock_guard<std::mutex> lock(list->mutex);
+			list->points.push_back(std::move(owned));
+		}
+	});
+	if (points->vertices.size() != count) {
+		points->vertices.resize(count);
+		points->tex_coords.resize(count);
+	}
+	return points;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MRKernels.h"
+
+/////////////////////////////////////////////////////////////////
+// Deprojection of the depth image on the CPU                 //
+/////////////////////////////////////////////////////////////////
+// Replaces rs2::pointcloud::calculate() and map_to():
+// the ray through every pixel only depends on the intrinsics (including the distortion), so it is
+// deprojected once into a table of rays and cached; per frame a point is just depth * depthScale * ray,
+// done with SIMD on all cores (see deprojectRows), followed by the projection into the color image.
+// With a scan range, a fused pass over the raw depth (see scanDepth) selects the pixels within it and
+// counts the Z-histogram, then only the selected pixels are deprojected.
+// Not thread-safe: one deprojector per calling thread (the processing thread of MRFramePipeline).
+class MRDeprojector
+{
+public:
+	// vertices and texture coordinates of one frame, shared with the queues and the render thread
+	struct Points
+	{
+		std::vector<rs2::vertex> vertices;			// kept at the size of the image, to be reused
+		std::vector<rs2::texture_coordinate> tex_coords;
+		size_t count = 0;			// valid points
+		bool clipped = false;		// only the points within range
+		ScanRange range = {};
+		std::vector<int> histogram;	// Z-histogram of all pixels (DEPTH_HISTOGRAM_BINS), empty if not requested
+
+		PointCloud cloud() const;
+	};
+
+	static const size_t MAX_TABLES;		// cached ray tables, e.g. one per decimation magnitude
+
+private:
+	struct RayTable
+	{
+		rs2_intrinsics intrinsics;
+		std::vector<float> x;	// (x, y, 1) is the ray of the pixel, z=1 m
+		std::vector<float> y;
+	};
+	std::list<RayTable> tables;		// most recently used first
+	// points released by the consumers, for reuse: the deleter of the last shared_ptr returns them under the lock,
+	// which orders the last reads of the consumer before the next writes; outlives the deprojector if need be
+	struct FreeList
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Points>> points;
+	};
+	std::shared_ptr<FreeList> freeList;
+	DepthScanScratch scanScratch;
+	std::vector<uint32_t> indices;		// of the pixels within the scan range
+
+public:
+	MRDeprojector() : freeList(std::make_shared<FreeList>()) {}
+	MRDeprojector(const MRDeprojector&) = delete;
+	MRDeprojector& operator=(const MRDeprojector&) = delete;
+
+	// the points of a Z16 depth frame, with the texture coordinates into the color image (if mapping is set);
+	// only those within range (if set) and the Z-histogram (if requested)
+	std::shared_ptr<Points> process(const rs2::depth_frame& depth, float depthScale, const ColorMapping* mapping,
+		const ScanRange* range = nullptr, bool histogram = false);
+
+	// deprojects a Z16 image of intrinsics.width x intrinsics.height into width*height points, in the order of the pixels;
+	// threads<=0 uses all cores
+	void deproject(const uint16_t* depth, int strideBytes, const rs2_intrinsics& intrinsics, float depthScale,
+		const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords,
+		int threads = 0, ESimdLevel level = simdLevel());
+	// the same for the pixels within range only, dense in the order of the pixels, and the Z-histogram (if set);
+	// returns the number of points
+	size_t deprojectClipped(const uint16_t* depth, int strideBytes, const rs2_intrinsics& intrinsics, float depthScale,
+		ScanRange range, const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords,
+		int* histogram, int threads = 0, ESimdLevel level = simdLevel());
+
+	size_t cachedTables() const { return tables.size(); }
+
+private:
+	const RayTable& rays(const rs2_intrinsics& intrinsics);
+	std::shared_ptr<Points> acquire(size_t count);
+};
@@ -0,0 +1,341 @@
+#include "MRFramePipeline.h"
+#include "MRProfiler.h"
+
+#include <iostream>
+#include <chrono>
+
+
+MRFramePipeline::MRFramePipeline(size_t captureDepth, size_t renderDepth)
+	: captureQueue(captureDepth), renderQueue(renderDepth), running(false), failed(false), density(1), colored(true), pointcloud(true), simdDeprojection(true)
+	, scanMinZ(0.0f), scanMaxZ(1.0f), histogram(false), passes(0), ended(false), processedCount(0), lostCount(0)
+{
+}
+
+MRFramePipeline::~MRFramePipeline()
+{
+	stop();
+}
+
+rs2::pipeline_profile MRFramePipeline::start()
+{
+	// Start streaming with default recommended configuration
+	//Calling pipeline's start() without any additional parameters will start the first device
+	// with its default streams.
+	//The start function returns the pipeline profile which the pipeline used to start the device
+	return start(rs2::config());
+}
+
+rs2::pipeline_profile MRFramePipeline::startPlayback(const std::string& file, bool realTime, int loops)
+{
+	playback = true;
+	this->realTime = realTime;
+	this->loops = loops;
+	rs2::config config;
+	config.enable_device_from_file(file, true);		// repeated, the passes are counted by endOfPass()
+	start(config);
+	// not in real time the playback reads the next frame as soon as the previous one is taken
+	profile.get_device().as<rs2::playback>().set_real_time(realTime);
+	std::cout << "playback of " << file << (realTime ? " in real time" : " as fast as processed")
+		<< (loops > 0 ? ", " + std::to_string(loops) + " passes" : ", looped") << std::endl;
+	return profile;
+}
+
+rs2::pipeline_profile MRFramePipeline::start(const rs2::config& config)
+{
+	profile = pipe.start(config);
+	for (auto&& sensor : profile.get_device().query_sensors()) {
+		if (auto depthSensor = sensor.as<rs2::depth_sensor>())
+			depthScale = depthSensor.get_depth_scale();
+		// the frames librealsense holds per stream: a deeper queue drops fewer frames, but they wait longer
+		if (sensor.supports(RS2_OPTION_FRAMES_QUEUE_SIZE)) {
+			if (frameQueueSize > 0)
+				sensor.set_option(RS2_OPTION_FRAMES_QUEUE_SIZE, (float)frameQueueSize);
+			frameQueueSize = (int)sensor.get_option(RS2_OPTION_FRAMES_QUEUE_SIZE);
+		}
+	}
+	startThreads();
+	return profile;
+}
+
+void MRFramePipeline::startSynthetic(const MRSyntheticOptions& options)
+{
+	synthetic.reset(new MRSyntheticDevice(options));
+	depthScale = synthetic->getScene().getDepthUnits();
+	synthetic->start(syncer);
+	startThreads();
+}
+
+void MRFramePipeline::startThreads()
+{
+	running = true;
+	captureThread = std::thread(&MRFramePipeline::captureLoop, this);
+	processThread = std::thread(&MRFramePipeline::processLoop, this);
+}
+
+void MRFramePipeline::stop()
+{
+	if (!running)
+		return;
+	running = false;
+	if (captureThread.joinable())
+		captureThread.join();
+	if (processThread.joinable())
+		processThread.join();
+	if (synthetic)
+		synthetic->stop();
+	else
+		pipe.stop();
+}
+
+bool MRFramePipeline::poll(Frame& frame)
+{
+	if (failed) {
+		std::lock_guard<std::mutex> lock(failureMutex);
+		std::rethrow_exception(failure);
+	}
+	return renderQueue.popLatest(frame);
+}
+
+bool MRFramePipeline::wait(Frame& frame, unsigned int timeout_ms)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (!poll(frame))
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now > deadline)
+			return false;
+		renderQueue.waitForEntry(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+void MRFramePipeline::setDensity(int density)
+{
+	this->density = density;
+}
+
+void MRFramePipeline::setColored(bool colored)
+{
+	this->colored = colored;
+}
+
+void MRFramePipeline::setPointcloud(bool pointcloud)
+{
+	this->pointcloud = pointcloud;
+}
+
+void MRFramePipeline::setSimdDeprojection(bool simdDeprojection)
+{
+	this->simdDeprojection = simdDeprojection;
+}
+
+void MRFramePipeline::setScanRange(ScanRange range)
+{
+	scanMinZ = range.minZ;
+	scanMaxZ = range.maxZ;
+}
+
+void MRFramePipeline::setHistogram(bool histogram)
+{
+	this->histogram = histogram;
+}
+
+void MRFramePipeline::setFrameQueueSize(int size)
+{
+	frameQueueSize = size;
+}
+
+void MRFramePipeline::setTimings(MRStageTimings* timings)
+{
+	this->timings = timings;
+}
+
+std::string MRFramePipeline::statusText() const
+{
+	std::string text = "capture queue " + std::to_string(captureQueue.size()) + "/" + std::to_string(captureQueue.capacity())
+		+ " (" + std::to_string(captureQueue.dropped()) + " dropped), render queue "
+		+ std::to_string(renderQueue.size()) + "/" + std::to_string(renderQueue.capacity())
+		+ " (" + std::to_string(renderQueue.dropped()) + " dropped), "
+		+ (frameQueueSize > 0 ? "librealsense queue " + std::to_string(frameQueueSize) + ", " : "")
+		+ std::to_string(lostCount) + " lost before capture";
+	if (playback)
+		text += ", playback pass " + std::to_string(passes + 1) + (loops > 0 ? "/" + std::to_string(loops) : "")
+			+ (realTime ? "" : " (not real time)");
+	return text;
+}
+
+bool MRFramePipeline::endOfPass(const rs2::frameset& frames)
+{
+	// the repeated playback starts over with the first frame of the recording, its frame number is smaller again
+	rs2::depth_frame depth = frames.get_depth_frame();
+	unsigned long long frameNumber = depth ? depth.get_frame_number() : frames.get_frame_number();
+	bool startsOver = frameNumber < lastFrameNumber;
+	lastFrameNumber = frameNumber;
+	if (!startsOver)
+		return false;
+	if (loops > 0 && passes + 1 >= loops)
+		ended = true;	// the first frame of the next pass is not captured any more
+	passes++;
+	return true;
+}
+
+MRFrameTag MRFramePipeline::tagFrames(const rs2::frameset& frames)
+{
+	MRFrameTag tag;
+	tag.arrival = std::chrono::steady_clock::now();
+	rs2::depth_frame depth = frames.get_depth_frame();
+	rs2::frame frame = depth ? rs2::frame(depth) : rs2::frame(frames);
+	tag.frameNumber = frame.get_frame_number();
+	tag.timestamp = frame.get_timestamp();
+	tag.domain = frame.get_frame_timestamp_domain();
+
+	// a gap in the frame numbers (not the start of the next pass of a recording) is a frame lost before it got here
+	if (lastTaggedNumber > 0 && tag.frameNumber > lastTaggedNumber + 1)
+		lostCount += tag.frameNumber - lastTaggedNumber - 1;
+	lastTaggedNumber = tag.frameNumber;
+
+	// the age of the frame needs a timestamp on the system clock, else the time of arrival in librealsense
+	// is the next best; the timestamps of a recording are the ones of the recording session
+	if (playback)
+		return tag;
+	double systemMillis = std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+	if (tag.domain == RS2_TIMESTAMP_DOMAIN_SYSTEM_TIME)
+		tag.sensorMillis = systemMillis - tag.timestamp;
+	else if (frame.supports_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL))
+		tag.sensorMillis = systemMillis - (double)frame.get_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL);
+	if (tag.sensorMillis < 0.0 || tag.sensorMillis > 10000.0)
+		tag.sensorMillis = -1.0;	// not on the same clock after all
+	return tag;
+}
+
+void MRFramePipeline::fail(std::exception_ptr exception)
+{
+	std::lock_guard<std::mutex> lock(failureMutex);
+	if (!failure)
+		failure = exception;
+	failed = true;
+}
+
+void MRFramePipeline::captureLoop()
+{
+	MR_PROFILE_THREAD("capture");
+	while (running)
+	{
+		try {
+			if (ended) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			// Wait for the next set of frames from the camera
+			// rs2::pipeline::wait_for_frames() can replace the device it uses in case of device error or disconnection.
+			MRStageTimer timer(timings, EMRStage::WAIT_FOR_FRAMES);
+			MR_PROFILE_ZONE("wait_for_frames");
+			Capture capture;
+			capture.frames = synthetic ? syncer.wait_for_frames(1000) : pipe.wait_for_frames(1000);
+			timer.stop();
+			if (playback && endOfPass(capture.frames) && ended)
+				continue;
+			capture.tag = tagFrames(capture.frames);
+			if (!playback || realTime) {
+				captureQueue.push(capture);
+				continue;
+			}
+			// not in real time no frame is dropped, the playback waits for the processing
+			while (running && !captureQueue.offer(capture))
+				captureQueue.waitForRoom(std::chrono::milliseconds(100));
+		}
+		catch (const rs2::error& e) {
+			if (running)
+				std::cerr << "capture: " << e.what() << std::endl;	// e.g. timeout, try again
+		}
+		catch (const std::exception&) {
+			fail(std::current_exception());	// e.g. out of memory, for the render thread to report
+			return;
+		}
+	}
+}
+
+void MRFramePipeline::processLoop()
+{
+	MR_PROFILE_THREAD("processing");
+	int appliedDensity = 1;
+	while (running)
+	{
+		Capture capture;
+		if (!captureQueue.pop(capture)) {
+			captureQueue.waitForEntry(std::chrono::milliseconds(100));	// woken by the capture thread
+			continue;
+		}
+
+		try {
+			int d = density;
+			if (d != appliedDensity) {
+				dec_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, (float)d);
+				appliedDensity = d;
+			}
+			process(capture, d, colored, pointcloud, simdDeprojection, ScanRange{ scanMinZ, scanMaxZ }, histogram);
+		}
+		catch (const rs2::error& e) {
+			std::cerr << "processing: " << e.what() << std::endl;
+		}
+		catch (const std::exception&) {
+			fail(std::current_exception());
+			return;
+		}
+		processedCount++;
+	}
+}
+
+void MRFramePipeline::process(Capture& capture, int density, bool colored, bool pointcloud, bool simdDeprojection,
+	ScanRange range, bool histogram)
+{
+	MR_PROFILE_ZONE("MRFramePipeline::process");
+	rs2::frameset& frames = capture.frames;
+	Frame frame;
+	frame.tag = capture.tag;
+	frame.depth = frames.get_depth_frame();
+	if (!frame.depth)
+		return;		//If one of them is unavailable, continue iteration
+
+	if (density > 1) {
+		MRStageTimer timer(timings, EMRStage::DECIMATION);
+		frame.depth = dec_filter.process(frame.depth);
+	}
+
+	frame.color = frames.get_color_frame();
+	// For cameras that don't have RGB sensor, we'll map the pointcloud to infrared instead of color
+	if (!frame.color || !colored)
+		frame.color = frames.get_infrared_frame();
+
+	auto depthProfile = frame.depth.get_profile();
+	auto colorProfile = frame.color.get_profile();
+	if (depthProfile.unique_id() != depthProfileId || colorProfile.unique_id() != colorProfileId) {
+		depthIntrinsics = depthProfile.as<rs2::video_stream_profile>().get_intrinsics();
+		colorIntrinsics = colorProfile.as<rs2::video_stream_profile>().get_intrinsics();
+		depthToColor = depthProfile.get_extrinsics_to(colorProfile);
+		depthProfileId = depthProfile.unique_id();
+		colorProfileId = colorProfile.unique_id();
+	}
+	frame.depthScale = depthScale;
+	frame.depthIntrinsics = depthIntrinsics;
+	frame.colorIntrinsics = colorIntrinsics;
+	frame.depthToColor = depthToColor;
+
+	if (pointcloud && simdDeprojection) {
+		ColorMapping mapping{ colorIntrinsics, depthToColor };
+		// one pass over the raw depth clips and counts the histogram, only the pixels within range are deprojected
+		MRStageTimer timer(timings, EMRStage::DEPROJECTION);
+		frame.deprojected = deprojector.process(frame.depth, depthScale, &mapping, &range, histogram);
+	}
+	else if (pointcloud) {
+		// Generate the pointcloud and texture mappings
+		MRStageTimer calculateTimer(timings, EMRStage::POINTCLOUD);
+		frame.points = pc.calculate(frame.depth);
+		calculateTimer.stop();
+		// Tell pointcloud object to map to this color frame
+		MRStageTimer mapTimer(timings, EMRStage::MAP_TO);
+		pc.map_to(frame.color);
+	}
+
+	renderQueue.push(std::move(frame));
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <exception>
+
+#include "MRFrameQueue.h"
+#include "MRDeprojector.h"
+#include "MRSyntheticDevice.h"
+#include "MRStageTimings.h"
+#include "MRLatency.h"
+
+/////////////////////////////////////////////////////////////////
+// Camera frames processed in a pipeline of threads           //
+/////////////////////////////////////////////////////////////////
+// capture thread:    pipe.wait_for_frames()                        --> captureQueue
+// processing thread: decimation, deprojection and texture mapping   --> renderQueue
+// render thread:     poll(), then upload and draw (MRDemo::run)
+// Each queue drops its oldest frame when full, so the renderer always gets the newest one.
+// A recording (.bag) replaces the camera with startPlayback(); unless it is replayed in real time,
+// the capture thread waits for room in the capture queue, so every recorded frame is processed.
+// startSynthetic() takes procedural frames from MRSyntheticDevice instead, combined by a syncer.
+// Each frameset is tagged on arrival (frame number, timestamp, see MRFrameTag), the tag travels with it to the display.
+// A librealsense error is logged and the stage goes on; any other exception ends the stage and is rethrown by poll().
+class MRFramePipeline
+{
+public:
+	struct Frame
+	{
+		rs2::points points;					// vertices and texture coordinates, ready for upload (rs2::pointcloud)
+		std::shared_ptr<MRDeprojector::Points> deprojected;	// or the same by MRDeprojector
+		rs2::depth_frame depth = rs2::frame();
+		rs2::video_frame color = rs2::frame();	// texture of the points (color or infrared)
+
+		// camera model, to deproject the depth on the GPU (see GlDepthCloud)
+		float depthScale = 0.001f;				// m per depth unit
+		rs2_intrinsics depthIntrinsics = {};
+		rs2_intrinsics colorIntrinsics = {};
+		rs2_extrinsics depthToColor = {};
+
+		MRFrameTag tag;						// of the frameset it was processed from
+
+		bool hasPoints() const { return points || deprojected; }
+		PointCloud pointCloud() const { return deprojected ? deprojected->cloud() : points ? PointCloud(points) : PointCloud(); }
+	};
+
+	// frameset as captured, waiting for the processing
+	struct Capture
+	{
+		rs2::frameset frames;
+		MRFrameTag tag;
+	};
+
+private:
+	rs2::pipeline pipe;	// RealSense pipeline, encapsulating the actual device and sensors
+	rs2::pipeline_profile profile;
+	rs2::decimation_filter dec_filter;	// to reduce the density
+	rs2::pointcloud pc;	// Pointcloud object, for calculating pointclouds and texture mappings
+	MRDeprojector deprojector;	// the same with cached rays, SIMD and all cores
+	std::unique_ptr<MRSyntheticDevice> synthetic;	// frames generated instead of the camera
+	rs2::syncer syncer;			// combines its depth and color frames into framesets
+
+	MRFrameQueue<Capture> captureQueue;
+	MRFrameQueue<Frame> renderQueue;
+	std::thread captureThread;
+	std::thread processThread;
+	std::atomic<bool> running;
+	std::atomic<bool> failed;
+	std::mutex failureMutex;
+	std::exception_ptr failure;			// the first exception which ended a stage
+
+	// parameters of the processing stage, set by the render thread
+	std::atomic<int> density;
+	std::atomic<bool> colored;
+	std::atomic<bool> pointcloud;		// calculate the points on the CPU, otherwise only depth and color are passed on
+	std::atomic<bool> simdDeprojection;	// calculate them with deprojector instead of pc
+	std::atomic<float> scanMinZ;		// deprojector skips the pixels outside of the scan range
+	std::atomic<float> scanMaxZ;
+	std::atomic<bool> histogram;		// deprojector counts the Z-histogram in the same pass
+
+	// playback of a recording instead of the camera
+	bool playback = false;
+	bool realTime = true;				// replay at the recorded rate, otherwise as fast as the frames are processed
+	int loops = 0;						// passes through the recording, 0..endless
+	unsigned long long lastFrameNumber = 0;
+	std::atomic<int> passes;			// completed passes, a pass ends when the frame numbers start over
+	std::atomic<bool> ended;			// the last pass is completed, no more frames are captured
+	std::atomic<size_t> processedCount;	// framesets taken from the capture queue and processed
+	unsigned long long lastTaggedNumber = 0;
+	std::atomic<unsigned long long> lostCount;	// frame numbers missing in the framesets of wait_for_frames()
+	int frameQueueSize = 0;				// RS2_OPTION_FRAMES_QUEUE_SIZE of the sensors, 0..default
+
+	MRStageTimings* timings = nullptr;	// durations of the capture and processing stages, none..not timed
+
+	// camera model of the last profiles, it only changes with them (e.g. another decimation magnitude)
+	float depthScale = 0.001f;
+	int depthProfileId = -1;
+	int colorProfileId = -1;
+	rs2_intrinsics depthIntrinsics = {};
+	rs2_intrinsics colorIntrinsics = {};
+	rs2_extrinsics depthToColor = {};
+
+public:
+	MRFramePipeline(size_t captureDepth = 2, size_t renderDepth = 2);
+	~MRFramePipeline();
+
+	rs2::pipeline_profile start();	// starts the first device with its default streams and the threads
+	// starts the playback of a recording (.bag) instead, looped for the given passes (0..endless)
+	rs2::pipeline_profile startPlayback(const std::string& file, bool realTime = true, int loops = 0);
+	// starts procedural frames instead
+	void startSynthetic(const MRSyntheticOptions& options);
+	void stop();
+
+	bool isPlayback() const { return playback; }
+	int completedPasses() const { return passes; }
+	// all passes of the recording are captured and processed
+	bool hasEnded() const { return ended && processedCount + captureQueue.dropped() == captureQueue.pushed(); }
+	size_t processed() const { return processedCount; }
+	// frames the camera numbered but wait_for_frames() never returned (lost in the device or librealsense)
+	unsigned long long lostFrames() const { return lostCount; }
+	// frames librealsense may hold per stream before it drops frames, set before start(), 0..its default
+	void setFrameQueueSize(int size);
+	int getFrameQueueSize() const { return frameQueueSize; }
+
+	// newest processed frame, false if there is none since the last call; rethrows the exception which ended a stage
+	bool poll(Frame& frame);
+	bool wait(Frame& frame, unsigned int timeout_ms = 5000);
+
+	void setDensity(int density);
+	void setColored(bool colored);
+	void setPointcloud(bool pointcloud);
+	void setSimdDeprojection(bool simdDeprojection);
+	void setScanRange(ScanRange range);
+	void setHistogram(bool histogram);
+	// times wait_for_frames, decimation and deprojection into timings (before start())
+	void setTimings(MRStageTimings* timings);
+
+	// statistics per stage
+	const MRFrameQueue<Capture>& getCaptureQueue() const { return captureQueue; }
+	const MRFrameQueue<Frame>& getRenderQueue() const { return renderQueue; }
+	std::string statusText() const;
+
+private:
+	rs2::pipeline_profile start(const rs2::config& config);
+	void startThreads();
+	bool endOfPass(const rs2::frameset& frames);
+	MRFrameTag tagFrames(const rs2::frameset& frames);
+	void fail(std::exception_ptr exception);
+	void captureLoop();
+	void processLoop();
+	void process(Capture& capture, int density, bool colored, bool pointcloud, bool simdDeprojection,
+		ScanRange range, bool histogram);
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////
+// Bounded lock-free queue between two stages of a pipeline  //
+///////////////////////////////////////////////////////////////
+// One producer and one consumer. When the queue is full, push() drops the oldest entry,
+// so a slow consumer never works on stale data: the producer then dequeues like a second
+// consumer, which the per-cell sequence numbers (bounded queue by D. Vyukov) allow without locks.
+// A stage which has nothing to do blocks in waitForEntry() or waitForRoom() instead of polling. It counts itself
+// as a waiter, so push and pop only take the mutex and notify while a stage is waiting.
+template<typename T>
+class MRFrameQueue
+{
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	const size_t mask;
+	std::atomic<size_t> enqueuePos;
+	std::atomic<size_t> dequeuePos;
+	std::atomic<size_t> pushedCount;
+	std::atomic<size_t> droppedCount;
+	std::atomic<int> waiters;			// stages within waitForEntry() or waitForRoom()
+	std::mutex waitMutex;
+	std::condition_variable changed;	// an entry was pushed or popped
+
+public:
+	// capacity is rounded up to a power of two (at least 2)
+	explicit MRFrameQueue(size_t capacity)
+		: mask(roundUp(capacity) - 1), enqueuePos(0), dequeuePos(0), pushedCount(0), droppedCount(0), waiters(0)
+	{
+		cells.reset(new Cell[mask + 1]);
+		for (size_t i = 0; i <= mask; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	MRFrameQueue(const MRFrameQueue&) = delete;
+	MRFrameQueue& operator=(const MRFrameQueue&) = delete;
+
+	// producer: enqueue, dropping the oldest entries if the queue is full
+	void push(T item)
+	{
+		while (!tryPush(item))
+		{
+			T oldest;
+			if (tryPop(oldest))
+				droppedCount++;
+		}
+		pushedCount++;
+		wake();
+	}
+
+	// producer: enqueue only if the queue is not full, for producers which wait instead of dropping
+	bool offer(T& item)
+	{
+		if (!tryPush(item))
+			return false;
+		pushedCount++;
+		wake();
+		return true;
+	}
+
+	// consumer: dequeue the oldest entry, false if the queue is empty
+	bool pop(T& item)
+	{
+		if (!tryPop(item))
+			return false;
+		wake();
+		return true;
+	}
+
+	// consumer: dequeue the newest entry, the older ones are counted as dropped
+	bool popLatest(T& item)
+	{
+		if (!tryPop(item))
+			return false;
+		T newer;
+		while (tryPop(newer))
+		{
+			item = std::move(newer);
+			droppedCount++;
+		}
+		wake();
+		return true;
+	}
+
+	// consumer: waits until the queue holds an entry, false if it is still empty after the timeout
+	bool waitForEntry(std::chrono::milliseconds timeout)
+	{
+		return waitFor(timeout, [this]() { return size() > 0; });
+	}
+
+	// producer: waits until offer() finds room, false if the queue is still full after the timeout
+	bool waitForRoom(std::chrono::milliseconds timeout)
+	{
+		return waitFor(timeout, [this]() { return size() < capacity(); });
+	}
+
+	size_t size() const
+	{
+		size_t enq = enqueuePos.load(std::memory_order_relaxed);
+		size_t deq = dequeuePos.load(std::memory_order_relaxed);
+		return (enq > deq) ? enq - deq : 0;
+	}
+	size_t capacity() const { return mask + 1; }
+	size_t pushed() const { return pushedCount.load(std::memory_order_relaxed); }
+	size_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+	template<typename Predicate>
+	bool waitFor(std::chrono::milliseconds timeout, Predicate done)
+	{
+		waiters.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);	// counted before done() reads the positions
+		bool result;
+		{
+			std::unique_lock<std::mutex> lock(waitMutex);
+			result = changed.wait_for(lock, timeout, done);
+		}
+		waiters.fetch_sub(1);
+		return result;
+	}
+
+	// wakes the waits to check their condition again
+	void wake()
+	{
+		// the positions are updated before the waiters are read: a waiter not counted yet sees the change in done()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_relaxed) == 0)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(waitMutex);	// a waiter is either before its check or waiting
+		}
+		changed.notify_all();
+	}
+
+	static size_t roundUp(size_t capacity)
+	{
+		size_t n = 2;
+		while (n < capacity)
+			n *= 2;
+		return n;
+	}
+
+	bool tryPush(T& item)
+	{
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {
+				return false;	// full
+			}
+			else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		cell->data = std::move(item);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T& item)
+	{
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells[pos & mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {
+				return false;	// empty
+			}
+			else {
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+		item = std::move(cell->data);
+		cell->data = T();	// release the frame right away
+		cell->sequence.store(pos + mask + 1, std::memory_order_release);
+		return true;
+	}
+};
@@ -0,0 +1,137 @@
+#include "MRGovernor.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+const double MRGovernor::WINDOW_MILLIS = 500.0;
+const double MRGovernor::DEGRADE_HOLDOFF = 1000.0;
+const double MRGovernor::IMPROVE_HOLDOFF = 3000.0;
+const double MRGovernor::DEGRADE_ABOVE = 1.10;
+const double MRGovernor::IMPROVE_BELOW = 0.80;
+
+
+MRGovernor::MRGovernor(MRSettings& settings) : settings(settings)
+{
+	reset();
+}
+
+void MRGovernor::reset()
+{
+	baseDensity = settings.density;
+	basePointSize = settings.point_size;
+	baseHistogram = settings.show_histogram;
+	basePip = settings.show_pip;
+	windowMillis = windowWork = 0.0;
+	windowFrames = 0;
+	sinceChangeMillis = 0.0;
+}
+
+void MRGovernor::restore()
+{
+	settings.density = baseDensity;
+	settings.point_size = basePointSize;
+	settings.show_histogram = baseHistogram;
+	settings.show_pip = basePip;
+	reset();
+}
+
+void MRGovernor::update(double frameMillis, double workMillis, bool optionalStages)
+{
+	windowMillis += frameMillis;
+	windowWork += workMillis;
+	windowFrames++;
+	sinceChangeMillis += frameMillis;
+	if (windowMillis < WINDOW_MILLIS)
+		return;
+
+	const double avgFrame = windowMillis / windowFrames;
+	const double avgWork = windowWork / windowFrames;
+	windowMillis = windowWork = 0.0;
+	windowFrames = 0;
+	if (!settings.governor)
+		return;
+
+	const double budget = 1000.0 / settings.target_fps;
+	bool changed = false;
+	const char* direction = "";
+	if (avgFrame > budget * DEGRADE_ABOVE && sinceChangeMillis >= DEGRADE_HOLDOFF) {
+		changed = degrade(optionalStages);
+		direction = " //degraded";
+	}
+	else if (avgFrame <= budget * DEGRADE_ABOVE && sinceChangeMillis >= IMPROVE_HOLDOFF) {
+		changed = improve(avgWork, budget);
+		direction = " //improved";
+	}
+	if (!changed)
+		return;
+
+	sinceChangeMillis = 0.0;
+	std::ostringstream times;
+	times << std::fixed << std::setprecision(1)
+		<< "frame=" << avgFrame << "ms work=" << avgWork << "ms target=" << budget << "ms";
+	std::cout << "governor: density=" << settings.density << " point_size=" << settings.point_size
+		<< " histogram=" << settings.show_histogram << " pip=" << settings.show_pip << direction
+		<< ", " << times.str() << std::endl;
+}
+
+bool MRGovernor::degrade(bool optionalStages)
+{
+	// the optional stages first, they cost time without adding to the pointcloud
+	if (optionalStages && settings.show_histogram) {
+		settings.show_histogram = false;
+		return true;
+	}
+	if (optionalStages && settings.show_pip) {
+		settings.show_pip = false;
+		return true;
+	}
+	if (settings.density < 8) {
+		applyDensity(settings.density + 1);
+		return true;
+	}
+	return false;
+}
+
+bool MRGovernor::improve(double avgWork, double budget)
+{
+	if (settings.density > baseDensity) {
+		// decimation by d leaves 1/d^2 of the points, predict the work for the next lower magnitude
+		double scale = (double)settings.density / (settings.density - 1);
+		if (avgWork * scale * scale >= budget * IMPROVE_BELOW)
+			return false;
+		applyDensity(settings.density - 1);
+		return true;
+	}
+	if (avgWork >= budget * IMPROVE_BELOW)
+		return false;
+	if (!settings.show_pip && basePip) {
+		settings.show_pip = true;
+		return true;
+	}
+	if (!settings.show_histogram && baseHistogram) {
+		settings.show_histogram = true;
+		return true;
+	}
+	return false;
+}
+
+void MRGovernor::applyDensity(int density)
+{
+	settings.density = density;
+	// fewer points are spread wider, larger points keep the surface closed
+	settings.point_size = basePointSize * density / baseDensity;
+}
+
+std::string MRGovernor::statusText() const
+{
+	if (!settings.governor)
+		return "governor off";
+	std::ostringstream ss;
+	ss << "governor " << settings.target_fps << " fps: density " << settings.density;
+	if (!settings.show_histogram)
+		ss << ", no histogram";
+	if (!settings.show_pip)
+		ss << ", no pip";
+	return ss.str();
+}
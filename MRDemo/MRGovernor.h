@@ -0,0 +1,54 @@
+#pragma once
+
+#include "MRScene.h"
+
+#include <string>
+
+/////////////////////////////////////////////////////////////////
+// Adaptive quality to hold a target frame-rate               //
+/////////////////////////////////////////////////////////////////
+// Measures the frame times of the render loop and trades quality for speed in steps:
+// degrade: histogram off --> picture-in-picture off --> density+1 (decimation, larger points)
+// improve: in the reverse order, back to the quality chosen by the user (see reset()).
+// Decisions are taken on averages over half a second, with a hold-off after each change and a
+// dead band between the thresholds (hysteresis), so the quality does not toggle every frame.
+class MRGovernor
+{
+private:
+	MRSettings& settings;
+	// quality chosen by the user, the governor never goes beyond
+	int baseDensity;
+	float basePointSize;
+	bool baseHistogram;
+	bool basePip;
+
+	double windowMillis = 0.0;	// accumulated frame time of the current window
+	double windowWork = 0.0;	// accumulated work time (without waiting for vsync)
+	int windowFrames = 0;
+	double sinceChangeMillis = 0.0;
+
+public:
+	static const double WINDOW_MILLIS;		// averaging window
+	static const double DEGRADE_HOLDOFF;	// ms after a change before degrading again (new frames need to arrive)
+	static const double IMPROVE_HOLDOFF;	// ms after a change before improving again
+	static const double DEGRADE_ABOVE;		// frame time / budget above which quality is reduced
+	static const double IMPROVE_BELOW;		// predicted work time / budget below which quality is raised
+
+	MRGovernor(MRSettings& settings);
+
+	// takes the current settings as the best quality to aim for (e.g. after the user changed them), keeping them
+	void reset();
+	// returns to the best quality taken by reset(), e.g. when the governor is switched off
+	void restore();
+
+	// frameMillis: time since the previous frame, workMillis: time spent rendering it;
+	// optionalStages: the active scene runs the histogram and picture-in-picture stages
+	void update(double frameMillis, double workMillis, bool optionalStages);
+
+	std::string statusText() const;
+
+private:
+	bool degrade(bool optionalStages);
+	bool improve(double avgWork, double budget);
+	void applyDensity(int density);
+};
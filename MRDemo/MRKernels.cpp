@@ -0,0 +1,846 @@
+#include "MRKernels.h"
+
+#include <librealsense2/rsutil.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <omp.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MR_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MR_TARGET_AVX2
+#else
+#define MR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+
+ESimdLevel simdLevel()
+{
+	static const ESimdLevel level = []() {
+#if defined(MR_X86)
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (osxsave && avx && (_xgetbv(0) & 6) == 6) {	// OS saves the YMM registers
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return SIMD_AVX2;
+		}
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return SIMD_AVX2;
+#endif
+		return SIMD_SSE;	// SSE2 is part of every x64 CPU (and the default of MSVC for x86)
+#else
+		return SIMD_SCALAR;
+#endif
+	}();
+	return level;
+}
+
+const char* simdLevelName(ESimdLevel level)
+{
+	switch (level) {
+	case SIMD_AVX2: return "AVX2";
+	case SIMD_SSE: return "SSE";
+	default: return "scalar";
+	}
+}
+
+
+static size_t compactScalar(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords)
+{
+	return clipAndEmit<true>(vertices, tex_coords, count, range, StorePoint{ outVertices, outTexCoords });
+}
+
+#if defined(MR_X86)
+
+// copies the points of one block whose bit is set in mask
+// the branchless loop always stores and only advances for survivors (out has room, as n <= input index)
+template<int N>
+static inline size_t storeSurvivors(unsigned int mask, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords,
+	rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords)
+{
+	if (mask == 0)
+		return 0;
+	if (mask == (1u << N) - 1) {
+		memcpy(outVertices, vertices, N * sizeof(rs2::vertex));
+		memcpy(outTexCoords, tex_coords, N * sizeof(rs2::texture_coordinate));
+		return N;
+	}
+	size_t n = 0;
+	for (int j = 0; j < N; j++)
+	{
+		outVertices[n] = vertices[j];
+		outTexCoords[n] = tex_coords[j];
+		n += (mask >> j) & 1;
+	}
+	return n;
+}
+
+// z-coordinates of 4 consecutive vertices: [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3]
+static inline __m128 loadZ4(const float* v)
+{
+	__m128 a = _mm_loadu_ps(v);
+	__m128 b = _mm_loadu_ps(v + 4);
+	__m128 c = _mm_loadu_ps(v + 8);
+	__m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));	// z0 z0 z1 z1
+	__m128 cc = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));	// z2 z2 z3 z3
+	return _mm_shuffle_ps(ab, cc, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static size_t compactSSE(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords)
+{
+	const __m128 minZ = _mm_set1_ps(range.minZ);
+	const __m128 maxZ = _mm_set1_ps(range.maxZ);
+	size_t n = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 z = loadZ4(&vertices[i].x);
+		// keep = !(z > maxZ) && !(z <= minZ), the negated compares are true for NaN like the scalar loop
+		__m128 keep = _mm_and_ps(_mm_cmpngt_ps(z, maxZ), _mm_cmpnle_ps(z, minZ));
+		n += storeSurvivors<4>(_mm_movemask_ps(keep), vertices + i, tex_coords + i, outVertices + n, outTexCoords + n);
+	}
+	return n + compactScalar(vertices + i, tex_coords + i, count - i, range, outVertices + n, outTexCoords + n);
+}
+
+MR_TARGET_AVX2
+static size_t compactAVX2(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords)
+{
+	const __m256 minZ = _mm256_set1_ps(range.minZ);
+	const __m256 maxZ = _mm256_set1_ps(range.maxZ);
+	size_t n = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(loadZ4(&vertices[i].x)), loadZ4(&vertices[i + 4].x), 1);
+		// keep = !(z > maxZ) && !(z <= minZ), the unordered compares are true for NaN like the scalar loop
+		__m256 keep = _mm256_and_ps(_mm256_cmp_ps(z, maxZ, _CMP_NGT_UQ), _mm256_cmp_ps(z, minZ, _CMP_NLE_UQ));
+		n += storeSurvivors<8>(_mm256_movemask_ps(keep), vertices + i, tex_coords + i, outVertices + n, outTexCoords + n);
+	}
+	return n + compactScalar(vertices + i, tex_coords + i, count - i, range, outVertices + n, outTexCoords + n);
+}
+
+#endif
+
+size_t compactScanRange(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords, ESimdLevel level)
+{
+#if defined(MR_X86)
+	if (level >= SIMD_AVX2 && simdLevel() >= SIMD_AVX2)
+		return compactAVX2(vertices, tex_coords, count, range, outVertices, outTexCoords);
+	if (level >= SIMD_SSE)
+		return compactSSE(vertices, tex_coords, count, range, outVertices, outTexCoords);
+#endif
+	return compactScalar(vertices, tex_coords, count, range, outVertices, outTexCoords);
+}
+
+size_t compactScanRangeParallel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords,
+	CompactionScratch& scratch, int threads, ESimdLevel level)
+{
+	const size_t CHUNK_SIZE = 16384;	// points, small enough to balance, big enough to hide the scheduling
+	const int chunks = (int)((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+	if (chunks < 2 || threads < 2)
+		return compactScanRange(vertices, tex_coords, count, range, outVertices, outTexCoords, level);
+
+	if (scratch.vertices.size() < count) {
+		scratch.vertices.resize(count);
+		scratch.tex_coords.resize(count);
+	}
+	scratch.offsets.resize(chunks + 1);
+	rs2::vertex* chunkVertices = scratch.vertices.data();
+	rs2::texture_coordinate* chunkTexCoords = scratch.tex_coords.data();
+	size_t* offsets = scratch.offsets.data();
+
+	// 1. every chunk is compacted into its own part of the scratch memory
+	#pragma omp parallel for num_threads(threads) schedule(dynamic)
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t start = c * CHUNK_SIZE;
+		size_t n = (c == chunks - 1) ? count - start : CHUNK_SIZE;
+		offsets[c] = compactScanRange(vertices + start, tex_coords + start, n, range,
+			chunkVertices + start, chunkTexCoords + start, level);
+	}
+
+	// 2. exclusive prefix sum: where the survivors of each chunk start in the output
+	size_t total = 0;
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t n = offsets[c];
+		offsets[c] = total;
+		total += n;
+	}
+	offsets[chunks] = total;
+
+	// 3. merge, keeping the order of the sequential compaction
+	#pragma omp parallel for num_threads(threads) schedule(static)
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t start = c * CHUNK_SIZE;
+		size_t n = offsets[c + 1] - offsets[c];
+		memcpy(outVertices + offsets[c], chunkVertices + start, n * sizeof(rs2::vertex));
+		memcpy(outTexCoords + offsets[c], chunkTexCoords + start, n * sizeof(rs2::texture_coordinate));
+	}
+	return total;
+}
+
+
+static void deprojectScalar(const uint16_t* depth, int width, float depthScale, const float* rayX, const float* rayY,
+	const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords)
+{
+	for (int x = 0; x < width; x++)
+	{
+		float z = depth[x] * depthScale;
+		vertices[x] = { z * rayX[x], z * rayY[x], z };
+		if (!mapping)
+			continue;
+		if (z == 0.f) {
+			tex_coords[x] = { 0.f, 0.f };	// no depth data, as rs2::pointcloud
+			continue;
+		}
+		float colorPoint[3], colorPixel[2];
+		rs2_transform_point_to_point(colorPoint, &mapping->depthToColor, vertices[x]);
+		rs2_project_point_to_pixel(colorPixel, &mapping->intrinsics, colorPoint);
+		tex_coords[x] = { colorPixel[0] / mapping->intrinsics.width, colorPixel[1] / mapping->intrinsics.height };
+	}
+}
+
+#if defined(MR_X86)
+
+// interleaves 4 points into x/y/z triplets
+static inline void storeXYZ4(float* out, __m128 x, __m128 y, __m128 z)
+{
+	__m128 xy01 = _mm_unpacklo_ps(x, y);							// x0 y0 x1 y1
+	__m128 xy23 = _mm_unpackhi_ps(x, y);							// x2 y2 x3 y3
+	__m128 z0x1 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));		// z0 z0 x1 x1
+	__m128 y1z1 = _mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3));	// y1 y1 z1 z1
+	__m128 z2x3 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2));	// z2 z2 x3 x3
+	__m128 y3z3 = _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3));	// y3 y3 z3 z3
+	_mm_storeu_ps(out, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));		// x0 y0 z0 x1
+	_mm_storeu_ps(out + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));	// y1 z1 x2 y2
+	_mm_storeu_ps(out + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));	// z2 x3 y3 z3
+}
+
+static void deprojectSSE(const uint16_t* depth, int width, float depthScale, const float* rayX, const float* rayY,
+	const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords)
+{
+	const __m128 scale = _mm_set1_ps(depthScale);
+	const bool distorted = mapping && mapping->intrinsics.model == RS2_DISTORTION_MODIFIED_BROWN_CONRADY;
+	const float* r = mapping ? mapping->depthToColor.rotation : nullptr;
+	const float* t = mapping ? mapping->depthToColor.translation : nullptr;
+	const float* k = mapping ? mapping->intrinsics.coeffs : nullptr;
+	int x = 0;
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i d = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + x)), _mm_setzero_si128());
+		__m128 pz = _mm_mul_ps(_mm_cvtepi32_ps(d), scale);
+		__m128 px = _mm_mul_ps(pz, _mm_loadu_ps(rayX + x));
+		__m128 py = _mm_mul_ps(pz, _mm_loadu_ps(rayY + x));
+		storeXYZ4(&vertices[x].x, px, py, pz);
+		if (!mapping)
+			continue;
+
+		// rs2_transform_point_to_point()
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[0]), px), _mm_mul_ps(_mm_set1_ps(r[3]), py)), _mm_mul_ps(_mm_set1_ps(r[6]), pz)), _mm_set1_ps(t[0]));
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[1]), px), _mm_mul_ps(_mm_set1_ps(r[4]), py)), _mm_mul_ps(_mm_set1_ps(r[7]), pz)), _mm_set1_ps(t[1]));
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[2]), px), _mm_mul_ps(_mm_set1_ps(r[5]), py)), _mm_mul_ps(_mm_set1_ps(r[8]), pz)), _mm_set1_ps(t[2]));
+		// rs2_project_point_to_pixel()
+		__m128 u = _mm_div_ps(cx, cz);
+		__m128 v = _mm_div_ps(cy, cz);
+		if (distorted)
+		{
+			__m128 r2 = _mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v));
+			__m128 f = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(k[0]), r2)),
+				_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(k[1]), r2), r2)), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(k[4]), r2), r2), r2));
+			u = _mm_mul_ps(u, f);
+			v = _mm_mul_ps(v, f);
+			__m128 du = _mm_add_ps(_mm_add_ps(u, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2 * k[2]), u), v)),
+				_mm_mul_ps(_mm_set1_ps(k[3]), _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.f), u), u))));
+			__m128 dv = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2 * k[3]), u), v)),
+				_mm_mul_ps(_mm_set1_ps(k[2]), _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.f), v), v))));
+			u = du;
+			v = dv;
+		}
+		u = _mm_div_ps(_mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(mapping->intrinsics.fx)), _mm_set1_ps(mapping->intrinsics.ppx)), _mm_set1_ps((float)mapping->intrinsics.width));
+		v = _mm_div_ps(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(mapping->intrinsics.fy)), _mm_set1_ps(mapping->intrinsics.ppy)), _mm_set1_ps((float)mapping->intrinsics.height));
+		// no depth data: (0,0) as rs2::pointcloud
+		__m128 valid = _mm_cmpneq_ps(pz, _mm_setzero_ps());
+		u = _mm_and_ps(u, valid);
+		v = _mm_and_ps(v, valid);
+		_mm_storeu_ps(&tex_coords[x].u, _mm_unpacklo_ps(u, v));
+		_mm_storeu_ps(&tex_coords[x + 2].u, _mm_unpackhi_ps(u, v));
+	}
+	deprojectScalar(depth + x, width - x, depthScale, rayX + x, rayY + x, mapping, vertices + x, tex_coords ? tex_coords + x : nullptr);
+}
+
+MR_TARGET_AVX2
+static inline void storeXYZ8(float* out, __m256 x, __m256 y, __m256 z)
+{
+	storeXYZ4(out, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z));
+	storeXYZ4(out + 12, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1));
+}
+
+MR_TARGET_AVX2
+static void deprojectAVX2(const uint16_t* depth, int width, float depthScale, const float* rayX, const float* rayY,
+	const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords)
+{
+	// no FMA: fused operations round differently than rsutil.h
+	const __m256 scale = _mm256_set1_ps(depthScale);
+	const bool distorted = mapping && mapping->intrinsics.model == RS2_DISTORTION_MODIFIED_BROWN_CONRADY;
+	const float* r = mapping ? mapping->depthToColor.rotation : nullptr;
+	const float* t = mapping ? mapping->depthToColor.translation : nullptr;
+	const float* k = mapping ? mapping->intrinsics.coeffs : nullptr;
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(depth + x)));
+		__m256 pz = _mm256_mul_ps(_mm256_cvtepi32_ps(d), scale);
+		__m256 px = _mm256_mul_ps(pz, _mm256_loadu_ps(rayX + x));
+		__m256 py = _mm256_mul_ps(pz, _mm256_loadu_ps(rayY + x));
+		storeXYZ8(&vertices[x].x, px, py, pz);
+		if (!mapping)
+			continue;
+
+		// rs2_transform_point_to_point()
+		__m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r[0]), px), _mm256_mul_ps(_mm256_set1_ps(r[3]), py)), _mm256_mul_ps(_mm256_set1_ps(r[6]), pz)), _mm256_set1_ps(t[0]));
+		__m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r[1]), px), _mm256_mul_ps(_mm256_set1_ps(r[4]), py)), _mm256_mul_ps(_mm256_set1_ps(r[7]), pz)), _mm256_set1_ps(t[1]));
+		__m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r[2]), px), _mm256_mul_ps(_mm256_set1_ps(r[5]), py)), _mm256_mul_ps(_mm256_set1_ps(r[8]), pz)), _mm256_set1_ps(t[2]));
+		// rs2_project_point_to_pixel()
+		__m256 u = _mm256_div_ps(cx, cz);
+		__m256 v = _mm256_div_ps(cy, cz);
+		if (distorted)
+		{
+			__m256 r2 = _mm256_add_ps(_mm256_mul_ps(u, u), _mm256_mul_ps(v, v));
+			__m256 f = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(_mm256_set1_ps(k[0]), r2)),
+				_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(k[1]), r2), r2)), _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(k[4]), r2), r2), r2));
+			u = _mm256_mul_ps(u, f);
+			v = _mm256_mul_ps(v, f);
+			__m256 du = _mm256_add_ps(_mm256_add_ps(u, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2 * k[2]), u), v)),
+				_mm256_mul_ps(_mm256_set1_ps(k[3]), _mm256_add_ps(r2, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.f), u), u))));
+			__m256 dv = _mm256_add_ps(_mm256_add_ps(v, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2 * k[3]), u), v)),
+				_mm256_mul_ps(_mm256_set1_ps(k[2]), _mm256_add_ps(r2, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.f), v), v))));
+			u = du;
+			v = dv;
+		}
+		u = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(u, _mm256_set1_ps(mapping->intrinsics.fx)), _mm256_set1_ps(mapping->intrinsics.ppx)), _mm256_set1_ps((float)mapping->intrinsics.width));
+		v = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(mapping->intrinsics.fy)), _mm256_set1_ps(mapping->intrinsics.ppy)), _mm256_set1_ps((float)mapping->intrinsics.height));
+		__m256 valid = _mm256_cmp_ps(pz, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+		u = _mm256_and_ps(u, valid);
+		v = _mm256_and_ps(v, valid);
+		__m256 lo = _mm256_unpacklo_ps(u, v);	// u0 v0 u1 v1 | u4 v4 u5 v5
+		__m256 hi = _mm256_unpackhi_ps(u, v);	// u2 v2 u3 v3 | u6 v6 u7 v7
+		_mm256_storeu_ps(&tex_coords[x].u, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(&tex_coords[x + 4].u, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	deprojectSSE(depth + x, width - x, depthScale, rayX + x, rayY + x, mapping, vertices + x, tex_coords ? tex_coords + x : nullptr);
+}
+
+#endif
+
+static void deprojectSpan(const uint16_t* depth, int count, float depthScale, const float* rayX, const float* rayY,
+	const ColorMapping* mapping, rs2::vertex* vertices, rs2::texture_coordinate* tex_coords, ESimdLevel level)
+{
+	// the f-theta model needs atan/tan per point, it is left to rsutil.h
+	if (mapping && mapping->intrinsics.model == RS2_DISTORTION_FTHETA)
+		level = SIMD_SCALAR;
+#if defined(MR_X86)
+	if (level >= SIMD_AVX2 && simdLevel() >= SIMD_AVX2)
+		deprojectAVX2(depth, count, depthScale, rayX, rayY, mapping, vertices, tex_coords);
+	else if (level >= SIMD_SSE)
+		deprojectSSE(depth, count, depthScale, rayX, rayY, mapping, vertices, tex_coords);
+	else
+#endif
+		deprojectScalar(depth, count, depthScale, rayX, rayY, mapping, vertices, tex_coords);
+}
+
+void deprojectRows(const uint16_t* depth, int strideBytes, int width, int row0, int row1, float depthScale,
+	const float* rayX, const float* rayY, const ColorMapping* mapping,
+	rs2::vertex* vertices, rs2::texture_coordinate* tex_coords, ESimdLevel level)
+{
+	for (int y = row0; y < row1; y++)
+	{
+		const uint16_t* row = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(depth) + (size_t)y * strideBytes);
+		size_t offset = (size_t)y * width;
+		deprojectSpan(row, width, depthScale, rayX + offset, rayY + offset, mapping,
+			vertices + offset, mapping ? tex_coords + offset : nullptr, level);
+	}
+}
+
+void deprojectIndexed(const uint16_t* depth, int strideBytes, int width, const uint32_t* indices, size_t count, float depthScale,
+	const float* rayX, const float* rayY, const ColorMapping* mapping,
+	rs2::vertex* vertices, rs2::texture_coordinate* tex_coords, ESimdLevel level)
+{
+	// gathered into blocks on the stack, then the same kernels as for whole rows
+	const size_t BLOCK_SIZE = 256;
+	uint16_t blockDepth[BLOCK_SIZE];
+	float blockRayX[BLOCK_SIZE];
+	float blockRayY[BLOCK_SIZE];
+	const bool packed = (strideBytes == width * (int)sizeof(uint16_t));
+	for (size_t start = 0; start < count; start += BLOCK_SIZE)
+	{
+		const size_t n = (count - start < BLOCK_SIZE) ? count - start : BLOCK_SIZE;
+		for (size_t k = 0; k < n; k++)
+		{
+			uint32_t i = indices[start + k];
+			blockDepth[k] = packed ? depth[i]
+				: reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(depth) + (size_t)(i / width) * strideBytes)[i % width];
+			blockRayX[k] = rayX[i];
+			blockRayY[k] = rayY[i];
+		}
+		deprojectSpan(blockDepth, (int)n, depthScale, blockRayX, blockRayY, mapping,
+			vertices + start, mapping ? tex_coords + start : nullptr, level);
+	}
+}
+
+
+// largest raw depth with depth * depthScale <= z, -1 if there is none
+static int32_t lastDepthAtOrBelow(float z, float depthScale)
+{
+	if (!(0.f <= z))
+		return -1;
+	double guess = std::floor(z / depthScale);
+	int32_t d = (int32_t)std::min(std::max(guess, 0.0), 65535.0);
+	// the same float multiplication as the deprojection decides at the boundary
+	while (d < 65535 && (float)(d + 1) * depthScale <= z)
+		d++;
+	while (d >= 0 && (float)d * depthScale > z)
+		d--;
+	return d;
+}
+
+RawScanRange toRawScanRange(ScanRange range, float depthScale)
+{
+	return { lastDepthAtOrBelow(range.minZ, depthScale), lastDepthAtOrBelow(range.maxZ, depthScale) };
+}
+
+template<bool Indices, bool Histogram>
+static size_t scanRows(const uint16_t* depth, int strideBytes, int width, int row0, int row1, RawScanRange raw,
+	const uint16_t* binOfDepth, uint32_t* indices, int* histogram)
+{
+	// minRaw < d <= maxRaw as a single unsigned comparison, no branch per pixel
+	const uint32_t low = (uint32_t)(raw.minRaw + 1);
+	const uint32_t span = (raw.maxRaw > raw.minRaw) ? (uint32_t)(raw.maxRaw - raw.minRaw) : 0;
+	size_t n = 0;
+	for (int y = row0; y < row1; y++)
+	{
+		const uint16_t* row = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(depth) + (size_t)y * strideBytes);
+		const uint32_t first = (uint32_t)y * width;
+		for (int x = 0; x < width; x++)
+		{
+			const uint32_t d = row[x];
+			if (Histogram)
+				histogram[binOfDepth[d]]++;
+			if (Indices) {
+				indices[n] = first + x;
+				n += (d - low < span) ? 1 : 0;
+			}
+		}
+	}
+	return n;
+}
+
+static size_t scanRows(const uint16_t* depth, int strideBytes, int width, int row0, int row1, RawScanRange raw,
+	const uint16_t* binOfDepth, uint32_t* indices, int* histogram)
+{
+	if (indices && histogram)
+		return scanRows<true, true>(depth, strideBytes, width, row0, row1, raw, binOfDepth, indices, histogram);
+	if (indices)
+		return scanRows<true, false>(depth, strideBytes, width, row0, row1, raw, binOfDepth, indices, histogram);
+	if (histogram)
+		return scanRows<false, true>(depth, strideBytes, width, row0, row1, raw, binOfDepth, indices, histogram);
+	return 0;
+}
+
+size_t scanDepth(const uint16_t* depth, int strideBytes, int width, int height, float depthScale, ScanRange range,
+	uint32_t* indices, int* histogram, DepthScanScratch& scratch, int threads)
+{
+	const RawScanRange raw = toRawScanRange(range, depthScale);
+	if (histogram && (scratch.depthScale != depthScale || scratch.binOfDepth.empty()))
+	{
+		// the bin of every raw depth, computed as from the vertices: (int)(z * 100) with z = d * depthScale
+		scratch.binOfDepth.resize(65536);
+		for (int d = 0; d < 65536; d++) {
+			int bin = (int)((float)d * depthScale * 100.f);
+			scratch.binOfDepth[d] = (bin > 0 && bin < DEPTH_HISTOGRAM_BINS) ? (uint16_t)bin : 0;
+		}
+		scratch.depthScale = depthScale;
+	}
+	const uint16_t* binOfDepth = scratch.binOfDepth.data();
+
+	const int CHUNK_ROWS = 16;	// a chunk of ~10k pixels
+	const int chunks = (height + CHUNK_ROWS - 1) / CHUNK_ROWS;
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+	if (chunks < 2 || threads < 2)
+	{
+		if (histogram)
+			memset(histogram, 0, DEPTH_HISTOGRAM_BINS * sizeof(int));
+		size_t n = scanRows(depth, strideBytes, width, 0, height, raw, binOfDepth, indices, histogram);
+		if (histogram)
+			histogram[0] = 0;
+		return n;
+	}
+
+	if (indices)
+		scratch.indices.resize((size_t)width * height);
+	scratch.offsets.resize(chunks + 1);
+	if (histogram)
+		scratch.histograms.assign((size_t)threads * DEPTH_HISTOGRAM_BINS, 0);
+	uint32_t* chunkIndices = indices ? scratch.indices.data() : nullptr;
+	size_t* offsets = scratch.offsets.data();
+
+	// 1. every chunk writes its indices into its own part of the scratch memory, every thread counts into its own histogram
+	#pragma omp parallel num_threads(threads)
+	{
+		int* threadHistogram = histogram ? scratch.histograms.data() + (size_t)omp_get_thread_num() * DEPTH_HISTOGRAM_BINS : nullptr;
+		#pragma omp for schedule(dynamic)
+		for (int c = 0; c < chunks; c++)
+		{
+			int row0 = c * CHUNK_ROWS;
+			int row1 = (row0 + CHUNK_ROWS < height) ? row0 + CHUNK_ROWS : height;
+			offsets[c] = scanRows(depth, strideBytes, width, row0, row1, raw, binOfDepth,
+				chunkIndices ? chunkIndices + (size_t)row0 * width : nullptr, threadHistogram);
+		}
+	}
+
+	// 2. merge the histograms of the threads
+	if (histogram)
+	{
+		memset(histogram, 0, DEPTH_HISTOGRAM_BINS * sizeof(int));
+		for (int t = 0; t < threads; t++) {
+			const int* threadHistogram = scratch.histograms.data() + (size_t)t * DEPTH_HISTOGRAM_BINS;
+			for (int b = 1; b < DEPTH_HISTOGRAM_BINS; b++)
+				histogram[b] += threadHistogram[b];
+		}
+	}
+	if (!indices)
+		return 0;
+
+	// 3. exclusive prefix sum of the chunk counts, then merge in the order of the pixels
+	size_t total = 0;
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t n = offsets[c];
+		offsets[c] = total;
+		total += n;
+	}
+	offsets[chunks] = total;
+
+	#pragma omp parallel for num_threads(threads) schedule(static)
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t n = offsets[c + 1] - offsets[c];
+		memcpy(indices + offsets[c], chunkIndices + (size_t)c * CHUNK_ROWS * width, n * sizeof(uint32_t));
+	}
+	return total;
+}
+
+
+// min/max as _mm_min_ps/_mm_max_ps: the second operand if the first is NaN
+static inline float minOf(float a, float b) { return a < b ? a : b; }
+static inline float maxOf(float a, float b) { return a > b ? a : b; }
+
+// the channels of a pixel in the low three bytes, grey replicated
+static inline uint32_t texel(const ColorImage& image, int x, int y)
+{
+	const uint8_t* p = image.data + (size_t)y * image.strideBytes + (size_t)x * image.bytesPerPixel;
+	if (image.bytesPerPixel < 3)
+		return p[0] * 0x010101u;
+	return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+// the same operations in the same order as the SIMD kernels, so all levels round alike (no FMA)
+static inline float lerpChannel(uint32_t t00, uint32_t t10, uint32_t t01, uint32_t t11, int shift, float fx, float fy)
+{
+	float c00 = (float)((t00 >> shift) & 0xFF), c10 = (float)((t10 >> shift) & 0xFF);
+	float c01 = (float)((t01 >> shift) & 0xFF), c11 = (float)((t11 >> shift) & 0xFF);
+	float top = c00 + (c10 - c00) * fx;
+	float bottom = c01 + (c11 - c01) * fx;
+	return top + (bottom - top) * fy;
+}
+
+static void sampleScalar(const rs2::texture_coordinate* tex_coords, size_t count, const ColorImage& image, ESampling sampling, uint8_t* rgb)
+{
+	const float w = (float)image.width, h = (float)image.height;
+	const int lastX = image.width - 1, lastY = image.height - 1;
+	for (size_t i = 0; i < count; i++, rgb += 3)
+	{
+		if (sampling == SAMPLE_NEAREST)
+		{
+			int x = (int)minOf(maxOf(tex_coords[i].u * w, 0.f), (float)lastX);
+			int y = (int)minOf(maxOf(tex_coords[i].v * h, 0.f), (float)lastY);
+			uint32_t t = texel(image, x, y);
+			rgb[0] = (uint8_t)t;
+			rgb[1] = (uint8_t)(t >> 8);
+			rgb[2] = (uint8_t)(t >> 16);
+			continue;
+		}
+		// texel centers at +0.5, limited to one pixel beyond the image (all of it weighs the edge pixel)
+		float x = minOf(maxOf(tex_coords[i].u * w - 0.5f, -1.f), w);
+		float y = minOf(maxOf(tex_coords[i].v * h - 0.5f, -1.f), h);
+		float x0 = std::floor(x), y0 = std::floor(y);
+		float fx = x - x0, fy = y - y0;
+		int ix0 = std::min(std::max((int)x0, 0), lastX), ix1 = std::min(std::max((int)x0 + 1, 0), lastX);
+		int iy0 = std::min(std::max((int)y0, 0), lastY), iy1 = std::min(std::max((int)y0 + 1, 0), lastY);
+		uint32_t t00 = texel(image, ix0, iy0), t10 = texel(image, ix1, iy0);
+		uint32_t t01 = texel(image, ix0, iy1), t11 = texel(image, ix1, iy1);
+		for (int c = 0; c < 3; c++)
+			rgb[c] = (uint8_t)(int)(lerpChannel(t00, t10, t01, t11, 8 * c, fx, fy) + 0.5f);
+	}
+}
+
+#if defined(MR_X86)
+
+// u0 v0 u1 v1 u2 v2 u3 v3 --> u0 u1 u2 u3, v0 v1 v2 v3
+static inline void loadUV4(const rs2::texture_coordinate* tex_coords, __m128& u, __m128& v)
+{
+	__m128 a = _mm_loadu_ps(&tex_coords[0].u);
+	__m128 b = _mm_loadu_ps(&tex_coords[2].u);
+	u = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+	v = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+static inline __m128i clampSSE(__m128i i, __m128i lo, __m128i hi)
+{
+	// SSE2 has no 32 bit integer min/max
+	__m128i below = _mm_cmplt_epi32(i, lo);
+	i = _mm_or_si128(_mm_and_si128(below, lo), _mm_andnot_si128(below, i));
+	__m128i above = _mm_cmpgt_epi32(i, hi);
+	return _mm_or_si128(_mm_and_si128(above, hi), _mm_andnot_si128(above, i));
+}
+
+static inline __m128 lerpChannelSSE(__m128i t00, __m128i t10, __m128i t01, __m128i t11, int shift, __m128 fx, __m128 fy)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	__m128 c00 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(t00, count), mask));
+	__m128 c10 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(t10, count), mask));
+	__m128 c01 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(t01, count), mask));
+	__m128 c11 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(t11, count), mask));
+	__m128 top = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), fx));
+	__m128 bottom = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), fx));
+	return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy));
+}
+
+static inline void storeRGB4(uint8_t* rgb, __m128i packed)
+{
+	alignas(16) uint32_t p[4];
+	_mm_store_si128((__m128i*)p, packed);
+	for (int k = 0; k < 4; k++) {
+		rgb[3 * k] = (uint8_t)p[k];
+		rgb[3 * k + 1] = (uint8_t)(p[k] >> 8);
+		rgb[3 * k + 2] = (uint8_t)(p[k] >> 16);
+	}
+}
+
+// SSE2 has no gather: the coordinates and the blending in SIMD, the pixels fetched one by one
+static void sampleSSE(const rs2::texture_coordinate* tex_coords, size_t count, const ColorImage& image, ESampling sampling, uint8_t* rgb)
+{
+	const __m128 w = _mm_set1_ps((float)image.width), h = _mm_set1_ps((float)image.height);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lastX = _mm_set1_epi32(image.width - 1), lastY = _mm_set1_epi32(image.height - 1);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128 half = _mm_set1_ps(0.5f), minusOne = _mm_set1_ps(-1.f);
+	alignas(16) int32_t x0[4], x1[4], y0[4], y1[4];
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 u, v;
+		loadUV4(tex_coords + i, u, v);
+		if (sampling == SAMPLE_NEAREST)
+		{
+			__m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(u, w), _mm_setzero_ps()), _mm_cvtepi32_ps(lastX));
+			__m128 y = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, h), _mm_setzero_ps()), _mm_cvtepi32_ps(lastY));
+			_mm_store_si128((__m128i*)x0, _mm_cvttps_epi32(x));
+			_mm_store_si128((__m128i*)y0, _mm_cvttps_epi32(y));
+			__m128i t = _mm_set_epi32(texel(image, x0[3], y0[3]), texel(image, x0[2], y0[2]), texel(image, x0[1], y0[1]), texel(image, x0[0], y0[0]));
+			storeRGB4(rgb + 3 * i, t);
+			continue;
+		}
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(u, w), half), minusOne), w);
+		__m128 y = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(v, h), half), minusOne), h);
+		// floor: truncation rounds the negative values up
+		__m128i ix = _mm_cvttps_epi32(x), iy = _mm_cvttps_epi32(y);
+		ix = _mm_add_epi32(ix, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(ix))));
+		iy = _mm_add_epi32(iy, _mm_castps_si128(_mm_cmplt_ps(y, _mm_cvtepi32_ps(iy))));
+		__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix)), fy = _mm_sub_ps(y, _mm_cvtepi32_ps(iy));
+		_mm_store_si128((__m128i*)x0, clampSSE(ix, zero, lastX));
+		_mm_store_si128((__m128i*)x1, clampSSE(_mm_add_epi32(ix, one), zero, lastX));
+		_mm_store_si128((__m128i*)y0, clampSSE(iy, zero, lastY));
+		_mm_store_si128((__m128i*)y1, clampSSE(_mm_add_epi32(iy, one), zero, lastY));
+		__m128i t00 = _mm_set_epi32(texel(image, x0[3], y0[3]), texel(image, x0[2], y0[2]), texel(image, x0[1], y0[1]), texel(image, x0[0], y0[0]));
+		__m128i t10 = _mm_set_epi32(texel(image, x1[3], y0[3]), texel(image, x1[2], y0[2]), texel(image, x1[1], y0[1]), texel(image, x1[0], y0[0]));
+		__m128i t01 = _mm_set_epi32(texel(image, x0[3], y1[3]), texel(image, x0[2], y1[2]), texel(image, x0[1], y1[1]), texel(image, x0[0], y1[0]));
+		__m128i t11 = _mm_set_epi32(texel(image, x1[3], y1[3]), texel(image, x1[2], y1[2]), texel(image, x1[1], y1[1]), texel(image, x1[0], y1[0]));
+		__m128i packed = zero;
+		for (int c = 0; c < 3; c++) {
+			__m128i channel = _mm_cvttps_epi32(_mm_add_ps(lerpChannelSSE(t00, t10, t01, t11, 8 * c, fx, fy), half));
+			packed = _mm_or_si128(packed, _mm_sll_epi32(channel, _mm_cvtsi32_si128(8 * c)));
+		}
+		storeRGB4(rgb + 3 * i, packed);
+	}
+	sampleScalar(tex_coords + i, count - i, image, sampling, rgb + 3 * i);
+}
+
+MR_TARGET_AVX2
+static inline void loadUV8(const rs2::texture_coordinate* tex_coords, __m256& u, __m256& v)
+{
+	__m256 a = _mm256_loadu_ps(&tex_coords[0].u);	// u0 v0 u1 v1 | u2 v2 u3 v3
+	__m256 b = _mm256_loadu_ps(&tex_coords[4].u);	// u4 v4 u5 v5 | u6 v6 u7 v7
+	// u0 u1 u4 u5 | u2 u3 u6 u7, then the 64 bit pairs in order
+	u = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+	v = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// the pixels at the byte offsets, as texel(): 4 bytes gathered per pixel, those which would read beyond
+// the end of the image are gathered from up to 3 bytes before and shifted into place
+MR_TARGET_AVX2
+static inline __m256i gatherTexels(const ColorImage& image, __m256i offsets, __m256i lastSafe)
+{
+	__m256i safe = _mm256_min_epi32(offsets, lastSafe);
+	__m256i t = _mm256_i32gather_epi32((const int*)image.data, safe, 1);
+	t = _mm256_srlv_epi32(t, _mm256_slli_epi32(_mm256_sub_epi32(offsets, safe), 3));
+	if (image.bytesPerPixel < 3)
+		return _mm256_mullo_epi32(_mm256_and_si256(t, _mm256_set1_epi32(0xFF)), _mm256_set1_epi32(0x010101));
+	return _mm256_and_si256(t, _mm256_set1_epi32(0xFFFFFF));
+}
+
+MR_TARGET_AVX2
+static inline __m256i offsetOf(__m256i x, __m256i y, __m256i stride, __m256i bpp)
+{
+	return _mm256_add_epi32(_mm256_mullo_epi32(y, stride), _mm256_mullo_epi32(x, bpp));
+}
+
+MR_TARGET_AVX2
+static inline __m256 lerpChannelAVX2(__m256i t00, __m256i t10, __m256i t01, __m256i t11, int shift, __m256 fx, __m256 fy)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	__m256 c00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t00, count), mask));
+	__m256 c10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t10, count), mask));
+	__m256 c01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t01, count), mask));
+	__m256 c11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t11, count), mask));
+	__m256 top = _mm256_add_ps(c00, _mm256_mul_ps(_mm256_sub_ps(c10, c00), fx));
+	__m256 bottom = _mm256_add_ps(c01, _mm256_mul_ps(_mm256_sub_ps(c11, c01), fx));
+	return _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fy));
+}
+
+// 8 pixels of 0x00bbggrr --> 24 bytes rgb
+MR_TARGET_AVX2
+static inline void storeRGB8(uint8_t* rgb, __m256i packed)
+{
+	const __m256i order = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	__m256i bytes = _mm256_shuffle_epi8(packed, order);
+	__m128i lo = _mm256_castsi256_si128(bytes), hi = _mm256_extracti128_si256(bytes, 1);
+	_mm_storel_epi64((__m128i*)rgb, lo);
+	uint32_t tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+	memcpy(rgb + 8, &tail, 4);
+	_mm_storel_epi64((__m128i*)(rgb + 12), hi);
+	tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+	memcpy(rgb + 20, &tail, 4);
+}
+
+MR_TARGET_AVX2
+static void sampleAVX2(const rs2::texture_coordinate* tex_coords, size_t count, const ColorImage& image, ESampling sampling, uint8_t* rgb)
+{
+	const size_t imageBytes = (size_t)(image.height - 1) * image.strideBytes + (size_t)image.width * image.bytesPerPixel;
+	if (imageBytes < 4 || imageBytes > INT32_MAX) {	// gathered with 32 bit offsets
+		sampleScalar(tex_coords, count, image, sampling, rgb);
+		return;
+	}
+	const __m256i lastSafe = _mm256_set1_epi32((int)(imageBytes - 4));
+	const __m256i stride = _mm256_set1_epi32(image.strideBytes), bpp = _mm256_set1_epi32(image.bytesPerPixel);
+	const __m256 w = _mm256_set1_ps((float)image.width), h = _mm256_set1_ps((float)image.height);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i lastX = _mm256_set1_epi32(image.width - 1), lastY = _mm256_set1_epi32(image.height - 1);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256 half = _mm256_set1_ps(0.5f), minusOne = _mm256_set1_ps(-1.f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 u, v;
+		loadUV8(tex_coords + i, u, v);
+		if (sampling == SAMPLE_NEAREST)
+		{
+			__m256i x = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(u, w), _mm256_setzero_ps()), _mm256_cvtepi32_ps(lastX)));
+			__m256i y = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, h), _mm256_setzero_ps()), _mm256_cvtepi32_ps(lastY)));
+			storeRGB8(rgb + 3 * i, gatherTexels(image, offsetOf(x, y, stride, bpp), lastSafe));
+			continue;
+		}
+		__m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_mul_ps(u, w), half), minusOne), w);
+		__m256 y = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_mul_ps(v, h), half), minusOne), h);
+		__m256 fx0 = _mm256_floor_ps(x), fy0 = _mm256_floor_ps(y);
+		__m256 fx = _mm256_sub_ps(x, fx0), fy = _mm256_sub_ps(y, fy0);
+		__m256i ix = _mm256_cvttps_epi32(fx0), iy = _mm256_cvttps_epi32(fy0);
+		__m256i x0 = _mm256_min_epi32(_mm256_max_epi32(ix, zero), lastX);
+		__m256i x1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(ix, one), zero), lastX);
+		__m256i y0 = _mm256_min_epi32(_mm256_max_epi32(iy, zero), lastY);
+		__m256i y1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iy, one), zero), lastY);
+		__m256i t00 = gatherTexels(image, offsetOf(x0, y0, stride, bpp), lastSafe);
+		__m256i t10 = gatherTexels(image, offsetOf(x1, y0, stride, bpp), lastSafe);
+		__m256i t01 = gatherTexels(image, offsetOf(x0, y1, stride, bpp), lastSafe);
+		__m256i t11 = gatherTexels(image, offsetOf(x1, y1, stride, bpp), lastSafe);
+		__m256i packed = zero;
+		for (int c = 0; c < 3; c++) {
+			__m256i channel = _mm256_cvttps_epi32(_mm256_add_ps(lerpChannelAVX2(t00, t10, t01, t11, 8 * c, fx, fy), half));
+			packed = _mm256_or_si256(packed, _mm256_sll_epi32(channel, _mm_cvtsi32_si128(8 * c)));
+		}
+		storeRGB8(rgb + 3 * i, packed);
+	}
+	sampleScalar(tex_coords + i, count - i, image, sampling, rgb + 3 * i);
+}
+
+#endif
+
+static void sampleSpan(const rs2::texture_coordinate* tex_coords, size_t count, const ColorImage& image, ESampling sampling,
+	uint8_t* rgb, ESimdLevel level)
+{
+#if defined(MR_X86)
+	if (level >= SIMD_AVX2 && simdLevel() >= SIMD_AVX2)
+		sampleAVX2(tex_coords, count, image, sampling, rgb);
+	else if (level >= SIMD_SSE)
+		sampleSSE(tex_coords, count, image, sampling, rgb);
+	else
+#endif
+		sampleScalar(tex_coords, count, image, sampling, rgb);
+}
+
+void sampleColors(const rs2::texture_coordinate* tex_coords, size_t count, const ColorImage& image, ESampling sampling,
+	uint8_t* rgb, int threads, ESimdLevel level)
+{
+	if (!image.data || image.width <= 0 || image.height <= 0) {
+		memset(rgb, 0, 3 * count);
+		return;
+	}
+	const size_t CHUNK_SIZE = 8192;		// points
+	const int chunks = (int)((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+	if (chunks < 2 || threads < 2) {
+		sampleSpan(tex_coords, count, image, sampling, rgb, level);
+		return;
+	}
+	#pragma omp parallel for num_threads(threads) schedule(static)
+	for (int c = 0; c < chunks; c++)
+	{
+		size_t start = c * CHUNK_SIZE;
+		size_t n = (c == chunks - 1) ? count - start : CHUNK_SIZE;
+		sampleSpan(tex_coords + start, n, image, sampling, rgb + 3 * start, level);
+	}
+}
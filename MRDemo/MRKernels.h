@@ -0,0 +1,247 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <vector>
+#include <cstdint>
+
+#include "GlPointBuffer.h"
+
+/////////////////////////////////////////////////////////////////
+// Point kernels, specialized at compile time                  //
+/////////////////////////////////////////////////////////////////
+// An effect is a small functor, which is inlined into the loop:
+//   void operator()(size_t rank, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+// rank ... index of the point among all points within the scan range
+// The scenes select the effect and the clipping once per frame (see MRScene*::renderKernel),
+// so the loops do not branch on settings or on the state of the scene.
+
+struct ScanRange
+{
+	float minZ;		// m, exclusive
+	float maxZ;		// m, inclusive
+};
+
+// the arrays of a pointcloud, calculated by rs2::pointcloud or by MRDeprojector
+struct PointCloud
+{
+	const rs2::vertex* vertices = nullptr;
+	const rs2::texture_coordinate* tex_coords = nullptr;
+	size_t count = 0;
+	bool clipped = false;				// holds only the points within range
+	ScanRange range = {};
+	const int* histogram = nullptr;		// Z-histogram of the whole depth image (DEPTH_HISTOGRAM_BINS), if calculated
+
+	PointCloud() {}
+	PointCloud(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count)
+		: vertices(vertices), tex_coords(tex_coords), count(count) {}
+	PointCloud(rs2::points points)
+		: vertices(points.get_vertices()), tex_coords(points.get_texture_coordinates()), count(points.size()) {}
+};
+
+// passes all points to the effect, dropping those outside of the scan range if Clip is set
+// returns the number of points passed to the effect
+template<bool Clip, typename Effect>
+inline size_t clipAndEmit(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, Effect effect)
+{
+	const float minZ = range.minZ;
+	const float maxZ = range.maxZ;
+	size_t rank = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (Clip && (vertices[i].z > maxZ || vertices[i].z <= minZ))
+			continue;
+		effect(rank, vertices[i], tex_coords[i]);
+		rank++;
+	}
+	return rank;
+}
+
+
+// effect: draw the point as it is, while clipping (a dense batch is copied at once with GlPointBuffer::add())
+struct EmitPoint
+{
+	GlPointBuffer& out;
+
+	void operator()(size_t, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		out.add(vertex, tex_coord);
+	}
+};
+
+// effect: count the point, but don't draw it
+struct SkipPoint
+{
+	void operator()(size_t, const rs2::vertex&, const rs2::texture_coordinate&) {}
+};
+
+// effect: copy the point into dense arrays
+struct StorePoint
+{
+	rs2::vertex* vertices;
+	rs2::texture_coordinate* tex_coords;
+
+	void operator()(size_t rank, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		vertices[rank] = vertex;
+		tex_coords[rank] = tex_coord;
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////
+// Counter-based random numbers                                //
+/////////////////////////////////////////////////////////////////
+// The random number of a point is a hash of its rank and of a key for the frame (from a seed and the frame number),
+// instead of the next number of a shared generator as std::rand(): no state, the same number for the same point
+// on every thread and in any order, plain 32 bit integer arithmetic which vectorizes, reproducible from the seed.
+// The hash is the finalizer of MurmurHash3, a bijection which spreads every input bit over all output bits.
+
+inline uint32_t mix32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x85EBCA6Bu;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35u;
+	x ^= x >> 16;
+	return x;
+}
+
+struct PointRandom
+{
+	uint32_t key;
+
+	PointRandom(uint32_t seed, uint32_t frame) : key(mix32(seed ^ mix32(frame + 0x9E3779B9u))) {}
+
+	// 32 random bits for the point of the given rank
+	uint32_t bits(size_t rank) const { return mix32(key + (uint32_t)rank * 0x9E3779B9u); }
+	// uniform in [0,1), 24 bits
+	float uniform(size_t rank) const { return (float)(bits(rank) >> 8) * (1.0f / 16777216.0f); }
+	// true with the probability p (0..1)
+	static uint32_t threshold(float p) { return p <= 0.f ? 0u : p >= 1.f ? 0xFFFFFFFFu : (uint32_t)((double)p * 4294967296.0); }
+	bool chance(size_t rank, uint32_t threshold) const { return bits(rank) < threshold; }
+};
+
+
+/////////////////////////////////////////////////////////////////
+// Stream compaction of the scan range                         //
+/////////////////////////////////////////////////////////////////
+
+enum ESimdLevel
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE = 1,		// SSE2, 4 points per step
+	SIMD_AVX2 = 2		// 8 points per step
+};
+
+ESimdLevel simdLevel();		// best level supported by CPU and OS, detected once
+const char* simdLevelName(ESimdLevel level);
+
+// copies all points within the scan range into the dense out-arrays (which must hold count points
+// and must not overlap the input), keeping their order; the result is identical for all levels
+// returns the number of points copied
+size_t compactScanRange(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords, ESimdLevel level = simdLevel());
+
+// memory of compactScanRangeParallel(), keep it across frames to avoid reallocations
+struct CompactionScratch
+{
+	std::vector<rs2::vertex> vertices;
+	std::vector<rs2::texture_coordinate> tex_coords;
+	std::vector<size_t> offsets;	// per chunk: number of survivors, then exclusive prefix sum
+};
+
+// same result as compactScanRange(), but the cloud is split into chunks which are compacted
+// by all threads (OpenMP) into scratch memory, then merged into the out-arrays at the
+// exclusive prefix sum of the chunk counts; threads<=0 uses all available threads
+size_t compactScanRangeParallel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count,
+	ScanRange range, rs2::vertex* outVertices, rs2::texture_coordinate* outTexCoords,
+	CompactionScratch& scratch, int threads = 0, ESimdLevel level = simdLevel());
+
+
+/////////////////////////////////////////////////////////////////
+// Deprojection of the depth image                             //
+/////////////////////////////////////////////////////////////////
+
+// projection of the points into the color image, as rs2::pointcloud::map_to()
+struct ColorMapping
+{
+	rs2_intrinsics intrinsics;		// of the color stream
+	rs2_extrinsics depthToColor;
+};
+
+// deprojects the rows [row0, row1) of a Z16 image with the rays of its pixels (see MRDeprojector):
+//   vertex = depth * depthScale * (rayX, rayY, 1), tex_coord = the vertex projected into the color image (if mapping is set)
+// the operations are those of rsutil.h in the same order, so all levels give the result of
+// rs2_deproject_pixel_to_point(), rs2_transform_point_to_point() and rs2_project_point_to_pixel()
+void deprojectRows(const uint16_t* depth, int strideBytes, int width, int row0, int row1, float depthScale,
+	const float* rayX, const float* rayY, const ColorMapping* mapping,
+	rs2::vertex* vertices, rs2::texture_coordinate* tex_coords, ESimdLevel level = simdLevel());
+
+// deprojects the pixels of a Z16 image listed in indices (y * width + x), e.g. by scanDepth(), into count dense points
+void deprojectIndexed(const uint16_t* depth, int strideBytes, int width, const uint32_t* indices, size_t count, float depthScale,
+	const float* rayX, const float* rayY, const ColorMapping* mapping,
+	rs2::vertex* vertices, rs2::texture_coordinate* tex_coords, ESimdLevel level = simdLevel());
+
+
+/////////////////////////////////////////////////////////////////
+// Fused pass over the raw depth image                         //
+/////////////////////////////////////////////////////////////////
+// Clipping and the Z-histogram straight from the Z16 pixels, before the deprojection:
+// the pixels outside of the scan range are neither converted to float nor deprojected.
+
+const int DEPTH_HISTOGRAM_BINS = 1000;	// cm, 0..10 m
+
+// a scan range in raw depth units: depth is within it if minRaw < depth <= maxRaw,
+// exactly when depth * depthScale is within the range in m (as the clipping of the vertices)
+struct RawScanRange
+{
+	int32_t minRaw;		// -1 if depth 0 is within the range
+	int32_t maxRaw;
+};
+RawScanRange toRawScanRange(ScanRange range, float depthScale);
+
+// memory of scanDepth(), keep it across frames to avoid reallocations
+struct DepthScanScratch
+{
+	float depthScale = 0.f;					// of binOfDepth
+	std::vector<uint16_t> binOfDepth;		// histogram bin per raw depth, 0..not counted
+	std::vector<uint32_t> indices;			// per chunk, at the chunk's first pixel
+	std::vector<size_t> offsets;			// per chunk: number of pixels within range, then exclusive prefix sum
+	std::vector<int> histograms;			// per thread, merged at the end
+};
+
+// one pass over a Z16 image by all threads (threads<=0), rows split into chunks:
+// - indices (if set, width*height entries): the pixels within the scan range, in the order of the pixels
+// - histogram (if set, DEPTH_HISTOGRAM_BINS entries): number of pixels per cm of depth, as
+//   (int)(depth * depthScale * 100) of all pixels in 1..999, overwritten
+// returns the number of indices
+size_t scanDepth(const uint16_t* depth, int strideBytes, int width, int height, float depthScale, ScanRange range,
+	uint32_t* indices, int* histogram, DepthScanScratch& scratch, int threads = 0);
+
+
+/////////////////////////////////////////////////////////////////
+// Colors of the points, sampled from the color image          //
+/////////////////////////////////////////////////////////////////
+
+// an 8 bit color image in memory, e.g. a rs2::video_frame of RS2_FORMAT_RGB8, RS2_FORMAT_RGBA8 or RS2_FORMAT_Y8
+struct ColorImage
+{
+	const uint8_t* data = nullptr;
+	int width = 0;
+	int height = 0;
+	int strideBytes = 0;
+	int bytesPerPixel = 3;	// 3: rgb, 4: rgba (alpha ignored), 1: grey
+};
+
+enum ESampling
+{
+	SAMPLE_NEAREST = 0,		// as GL_NEAREST
+	SAMPLE_BILINEAR = 1		// as GL_LINEAR, with the edge pixels repeated beyond the image
+};
+
+// the color of every point at its texture coordinate (0..1 across the image, as from rs2::pointcloud::map_to()),
+// packed into count rgb triplets; all levels give the same colors, threads<=0 uses all available threads
+void sampleColors(const rs2::texture_coordinate* tex_coords, size_t count, const ColorImage& image, ESampling sampling,
+	uint8_t* rgb, int threads = 0, ESimdLevel level = simdLevel());
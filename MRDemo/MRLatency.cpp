@@ -0,0 +1,102 @@
+#include "MRLatency.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+MRLatency::MRLatency()
+{
+	reset();
+}
+
+const char* MRLatency::name(EMRLatency latency)
+{
+	switch (latency) {
+	case EMRLatency::CAPTURE: return "capture to display";
+	case EMRLatency::ARRIVAL: return "arrival to display";
+	default: return "?";
+	}
+}
+
+void MRLatency::shown(const MRFrameTag& tag, std::chrono::steady_clock::time_point displayed)
+{
+	if (!tag.isTagged())
+		return;
+	// a recording played in a loop starts over with smaller frame numbers
+	if (shownCount > 0 && tag.frameNumber > lastFrameNumber)
+		skippedCount += tag.frameNumber - lastFrameNumber - 1;
+	lastFrameNumber = tag.frameNumber;
+	shownCount++;
+
+	double arrivalMillis = std::chrono::duration<double, std::milli>(displayed - tag.arrival).count();
+	auto add = [&](EMRLatency latency, double millis) {
+		Histogram& histogram = histograms[(int)latency];
+		histogram.bins[std::min(std::max((int)(millis / BIN_MILLIS), 0), BINS - 1)]++;
+		histogram.frames++;
+		histogram.sum += millis;
+		histogram.max = std::max(histogram.max, millis);
+	};
+	add(EMRLatency::ARRIVAL, arrivalMillis);
+	if (tag.sensorMillis >= 0.0)
+		add(EMRLatency::CAPTURE, tag.sensorMillis + arrivalMillis);
+}
+
+void MRLatency::reset()
+{
+	for (Histogram& histogram : histograms) {
+		std::fill(histogram.bins, histogram.bins + BINS, (size_t)0);
+		histogram.frames = 0;
+		histogram.sum = 0.0;
+		histogram.max = 0.0;
+	}
+	lastFrameNumber = 0;
+	shownCount = 0;
+	skippedCount = 0;
+}
+
+MRLatency::Summary MRLatency::summary(EMRLatency latency) const
+{
+	const Histogram& histogram = histograms[(int)latency];
+	Summary summary;
+	summary.frames = histogram.frames;
+	if (summary.frames == 0)
+		return summary;
+
+	// nearest rank, the bin holding it stands for its upper end (but not above the maximum)
+	auto rank = [&](double p) {
+		size_t target = std::max((size_t)std::ceil(p * histogram.frames), (size_t)1);
+		size_t count = 0;
+		int bin = 0;
+		for (; bin < BINS - 1; bin++) {
+			count += histogram.bins[bin];
+			if (count >= target)
+				break;
+		}
+		return std::min((double)(bin + 1) * BIN_MILLIS, histogram.max);
+	};
+	summary.mean = histogram.sum / histogram.frames;
+	summary.p50 = rank(0.50);
+	summary.p95 = rank(0.95);
+	summary.p99 = rank(0.99);
+	summary.max = histogram.max;
+	return summary;
+}
+
+std::string MRLatency::statusText() const
+{
+	bool capture = histograms[(int)EMRLatency::CAPTURE].frames > 0;
+	Summary summary = this->summary(capture ? EMRLatency::CAPTURE : EMRLatency::ARRIVAL);
+	return "latency " + std::to_string((int)std::round(summary.p50)) + " ms p50, " + std::to_string((int)std::round(summary.p99))
+		+ " ms p99 (" + name(capture ? EMRLatency::CAPTURE : EMRLatency::ARRIVAL) + "), "
+		+ std::to_string(skippedCount) + " of " + std::to_string(shownCount + skippedCount) + " frames not shown";
+}
+
+bool MRLatency::writeCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	file << "bin_ms,capture_frames,arrival_frames\n";
+	for (int bin = 0; bin < BINS; bin++)
+		file << bin * BIN_MILLIS << "," << histograms[(int)EMRLatency::CAPTURE].bins[bin] << ","
+			<< histograms[(int)EMRLatency::ARRIVAL].bins[bin] << "\n";
+	return (bool)file;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// where a frame comes from, tagged by the capture thread and carried with it up to the display
+struct MRFrameTag
+{
+	unsigned long long frameNumber = 0;	// of the depth frame
+	double timestamp = 0.0;				// rs2 frame timestamp, ms
+	rs2_timestamp_domain domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+	std::chrono::steady_clock::time_point arrival;	// wait_for_frames() returned it
+	double sensorMillis = -1.0;			// from the timestamp to the arrival, <0..unknown (hardware clock, playback)
+
+	bool isTagged() const { return arrival.time_since_epoch().count() != 0; }
+};
+
+/////////////////////////////////////////////////////////////////
+// Latency from the capture of a frame to its display         //
+/////////////////////////////////////////////////////////////////
+// shown() is called once per frame, with the end of the buffer swap that first showed it. The latencies are
+// counted in histograms of BIN_MILLIS wide bins, the last bin takes everything above. Two spans are kept:
+// CAPTURE from the sensor timestamp (only where it is on the system clock), ARRIVAL from wait_for_frames().
+// Gaps in the shown frame numbers are frames that were captured by the camera but never shown, be it lost in
+// librealsense or dropped by the queues of MRFramePipeline. Only the render thread uses it.
+enum class EMRLatency { CAPTURE, ARRIVAL, COUNT };
+
+class MRLatency
+{
+public:
+	static const int BINS = 200;
+	static const int BIN_MILLIS = 1;
+
+	struct Summary
+	{
+		size_t frames = 0;
+		double mean = 0.0;		// ms
+		double p50 = 0.0;		// upper end of the bin
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+private:
+	struct Histogram
+	{
+		size_t bins[BINS];
+		size_t frames;
+		double sum;
+		double max;
+	};
+	Histogram histograms[(int)EMRLatency::COUNT];
+
+	unsigned long long lastFrameNumber = 0;
+	unsigned long long shownCount = 0;
+	unsigned long long skippedCount = 0;	// frame numbers between the shown ones
+
+public:
+	MRLatency();
+
+	static const char* name(EMRLatency latency);
+
+	void shown(const MRFrameTag& tag, std::chrono::steady_clock::time_point displayed);
+	void reset();
+
+	Summary summary(EMRLatency latency) const;
+	const size_t* bins(EMRLatency latency) const { return histograms[(int)latency].bins; }
+	unsigned long long shownFrames() const { return shownCount; }
+	unsigned long long skippedFrames() const { return skippedCount; }
+	std::string statusText() const;
+	// one line per bin: bin_ms,capture_frames,arrival_frames
+	bool writeCsv(const std::string& path) const;
+};
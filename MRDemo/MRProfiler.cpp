@@ -0,0 +1,109 @@
+#include "MRProfiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+MRProfiler::MRProfiler() : start(std::chrono::steady_clock::now())
+{
+}
+
+MRProfiler& MRProfiler::instance()
+{
+	static MRProfiler profiler;
+	return profiler;
+}
+
+MRProfiler::ThreadEvents& MRProfiler::threadEvents()
+{
+	// registered on the first event of the thread, kept after its end so its events stay in the trace
+	static thread_local ThreadEvents* current = nullptr;
+	if (!current) {
+		std::unique_ptr<ThreadEvents> events(new ThreadEvents);
+		events->events.reset(new Event[EVENTS_PER_THREAD]);
+		events->count = 0;
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		events->id = (uint32_t)threads.size() + 1;
+		events->name = "thread " + std::to_string(events->id);
+		current = events.get();
+		threads.push_back(std::move(events));
+	}
+	return *current;
+}
+
+void MRProfiler::setThreadName(const char* name)
+{
+	ThreadEvents& events = threadEvents();
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	events.name = name;
+}
+
+void MRProfiler::zone(const char* name, uint64_t startNanos, uint64_t endNanos)
+{
+	ThreadEvents& events = threadEvents();
+	uint64_t count = events.count.load(std::memory_order_relaxed);
+	events.events[count % EVENTS_PER_THREAD] = { name, startNanos, endNanos };
+	events.count.store(count + 1, std::memory_order_release);
+}
+
+void MRProfiler::frame()
+{
+	uint64_t now = nanos();
+	zone(nullptr, now, now);
+}
+
+size_t MRProfiler::eventCount()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	size_t count = 0;
+	for (auto& events : threads)
+		count += (size_t)std::min<uint64_t>(events->count, EVENTS_PER_THREAD);
+	return count;
+}
+
+static void writeMicros(std::ostream& out, uint64_t nanos)
+{
+	out << nanos / 1000 << "." << std::setw(3) << std::setfill('0') << nanos % 1000;
+}
+
+bool MRProfiler::writeChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+	std::vector<Event> copy;
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	for (auto& events : threads)
+	{
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << events->id
+			<< ",\"args\":{\"name\":\"" << events->name << "\"}}";
+		first = false;
+
+		// the thread keeps recording: copy its ring, then drop the events it may have overwritten meanwhile,
+		// including the slot of the event it may be writing right now (number overwritten, not counted yet)
+		uint64_t end = events->count.load(std::memory_order_acquire);
+		uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+		copy.resize((size_t)(end - begin));
+		for (uint64_t i = begin; i < end; i++)
+			copy[(size_t)(i - begin)] = events->events[i % EVENTS_PER_THREAD];
+		uint64_t overwritten = events->count.load(std::memory_order_acquire);
+		uint64_t valid = overwritten >= EVENTS_PER_THREAD ? overwritten - EVENTS_PER_THREAD + 1 : 0;
+		for (uint64_t i = std::max(begin, valid); i < end; i++)
+		{
+			const Event& event = copy[(size_t)(i - begin)];
+			if (event.name) {
+				file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << events->id << ",\"ts\":";
+				writeMicros(file, event.startNanos);
+				file << ",\"dur\":";
+				writeMicros(file, event.endNanos - event.startNanos);
+			}
+			else {
+				file << ",\n{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":" << events->id << ",\"ts\":";
+				writeMicros(file, event.startNanos);
+			}
+			file << "}";
+		}
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
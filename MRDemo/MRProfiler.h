@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////
+// Zones and frame markers for chrome://tracing and Perfetto   //
+/////////////////////////////////////////////////////////////////
+// MR_PROFILE_ZONE("name") records the time spent in its scope, MR_PROFILE_FRAME() marks the start of a frame.
+// Each thread writes into its own ring of events (no locks, the oldest events are overwritten), so the
+// trace written by writeChromeTrace() holds the last EVENTS_PER_THREAD zones of every thread, interleaved
+// on a common time line. Names are string literals, only their pointers are stored.
+// Without MR_PROFILER defined (see the project settings) the macros compile to nothing.
+class MRProfiler
+{
+public:
+	static const size_t EVENTS_PER_THREAD = 65536;	// ~30s of MRDemo at 60 fps
+
+	struct Event
+	{
+		const char* name;		// nullptr..frame marker
+		uint64_t startNanos;	// since the start of the profiler
+		uint64_t endNanos;
+	};
+
+private:
+	struct ThreadEvents
+	{
+		std::string name;
+		uint32_t id;
+		std::unique_ptr<Event[]> events;
+		std::atomic<uint64_t> count;	// events recorded, the next one goes to count % EVENTS_PER_THREAD
+	};
+
+	const std::chrono::steady_clock::time_point start;
+	std::mutex threadsMutex;		// only to register a thread and to write the trace
+	std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+	MRProfiler();
+	ThreadEvents& threadEvents();
+
+public:
+	static MRProfiler& instance();
+
+	uint64_t nanos() const
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// names the calling thread in the trace, e.g. "render" (otherwise "thread <n>")
+	void setThreadName(const char* name);
+	void zone(const char* name, uint64_t startNanos, uint64_t endNanos);
+	void frame();
+
+	// JSON Trace Event Format: complete events ("X") per zone, global instant events ("i") per frame
+	bool writeChromeTrace(const std::string& path);
+	size_t eventCount();	// events within the rings
+};
+
+// records its scope as a zone of the calling thread
+class MRProfileZone
+{
+	const char* name;
+	uint64_t startNanos;
+
+public:
+	explicit MRProfileZone(const char* name) : name(name), startNanos(MRProfiler::instance().nanos()) {}
+	MRProfileZone(const MRProfileZone&) = delete;
+	MRProfileZone& operator=(const MRProfileZone&) = delete;
+	~MRProfileZone()
+	{
+		MRProfiler& profiler = MRProfiler::instance();
+		profiler.zone(name, startNanos, profiler.nanos());
+	}
+};
+
+#define MR_PROFILE_CONCAT2(a, b) a##b
+#define MR_PROFILE_CONCAT(a, b) MR_PROFILE_CONCAT2(a, b)
+#ifdef MR_PROFILER
+#define MR_PROFILE_ZONE(name) MRProfileZone MR_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define MR_PROFILE_FRAME() MRProfiler::instance().frame()
+#define MR_PROFILE_THREAD(name) MRProfiler::instance().setThreadName(name)
+#else
+#define MR_PROFILE_ZONE(name) ((void)0)
+#define MR_PROFILE_FRAME() ((void)0)
+#define MR_PROFILE_THREAD(name) ((void)0)
+#endif
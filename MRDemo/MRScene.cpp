@@ -1,83 +1,134 @@
 #include <imgui/imgui.h>
 #include "imgui/imgui_impl_glfw.h"
 
+#ifdef _WIN32
 #define NOMINMAX
-#include <Windows.h>				// GetTickCount(), PlaySound()
+#include <Windows.h>				// PlaySound()
 #pragma comment(lib, "Winmm.lib")	// PlaySound()
+#endif
 
 #include "MRScene.h"
+#include "MRProfiler.h"
+#include "GlTimerQueries.h"
 
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <atomic>
+#include <chrono>
+#include <algorithm>            // std::min
 #include <omp.h>
 
 
+// plays a .wav from the working directory without waiting for it, only on Windows
+static void playSound(const char* file, bool loop = false)
+{
+#ifdef _WIN32
+	PlaySound(file, GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC | (loop ? SND_LOOP : 0));
+#endif
+}
+
 MRScene::MRScene(MRSettings& settings) : settings(settings)
 {
 }
 
+long MRScene::currentMillis() const
+{
+	return (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void MRScene::preRenderPointCloud()
 {
 	animAgeMillis = 0;
 	if (animStartMillis > 0) {
-		animAgeMillis = GetTickCount() - animStartMillis;
+		animAgeMillis = currentMillis() - animStartMillis;
 	}
 }
 
-int MRScene::renderPointCloud(rs2::points points)
+int MRScene::renderPointCloud(PointCloud points, unsigned long cloud)
 {
-	auto vertices = points.get_vertices();              // get vertices
-	auto tex_coords = points.get_texture_coordinates(); // and texture coordinates
+	MR_PROFILE_ZONE("MRScene::renderPointCloud");
+	// the render loop runs faster than the camera, so mostly the cloud of the last frame is drawn again:
+	// only a new cloud, another scan range or state, or an animation needs the points to be processed
+	const ScanRange range{ settings.scanMinZ, settings.scanMaxZ };
+	if (cloud != renderedCloud || range.minZ != renderedRange.minZ || range.maxZ != renderedRange.maxZ
+		|| state != renderedState || isAnimated())
+	{
+		if (points.clipped && points.range.minZ == range.minZ && points.range.maxZ == range.maxZ) {
+			// already clipped by the fused pass over the raw depth (see MRDeprojector)
+			pointBuffer.clear(2 * points.count);	// IBC emits up to two points per input point
+			renderedPointCount = renderBatch(points.vertices, points.tex_coords, points.count, pointBuffer);
+		}
+		else {
+			renderedPointCount = processPointCloud(points.vertices, points.tex_coords, points.count);
+		}
+		renderedCloud = cloud;
+		renderedRange = range;
+		renderedState = state;
+	}
+	GlTimerScope gpuTimer(EMRStage::GPU_POINTS);
+	pointBuffer.draw(settings.use_vbo);
+	return renderedPointCount;
+}
 
-	glBegin(GL_POINTS);
+int MRScene::renderDepthCloud(GlDepthCloud& depthCloud, rs2::depth_frame depth, unsigned long cloud)
+{
+	renderedCloud = 0;	// pointBuffer no longer holds the current points
+	GlTimerScope gpuTimer(EMRStage::GPU_POINTS);
+	return depthCloud.draw(settings.scanMinZ, settings.scanMaxZ);
+}
 
-	//Method 1: Linear for-loop (on the CPU) --> 7.1/8.0 fps on 33% battery
-	int totalPointCount = 0;
-	for (unsigned int i = 0; i < points.size(); i++)
-	{
-		if (vertices[i].z > settings.scanMaxZ || vertices[i].z <= settings.scanMinZ)
-			continue;
-		totalPointCount += renderPoint(vertices[i], tex_coords[i]);
+int MRScene::processPointCloud(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count)
+{
+	const ScanRange range{ settings.scanMinZ, settings.scanMaxZ };
+	if (simdLevel() == SIMD_SCALAR) {
+		// without SIMD a single pass, clipping while emitting, is faster
+		pointBuffer.clear(count);
+		return clipAndRenderBatch(vertices, tex_coords, count, range, pointBuffer);
 	}
 
-//	//Method 2: Using OpenMP to try to parallelise the loop --> 8.0/9.1 fps on 33% battery
-//#define NUM_THREADS 4
-//	const int block = points.size() / NUM_THREADS;
-//	std::atomic<int> totalPointCount = 0;
-//	#pragma omp parallel num_threads(NUM_THREADS) 
-//	//for (int t = 0; t < NUM_THREADS; t++)
-//	{
-//		int t = omp_get_thread_num();
-//		const int start = t;// *block;
-//		//const int end = start + block;
-//		int pc = 0;
-//		for (unsigned int i = start; i < points.size(); i+=NUM_THREADS)
-//		{
-//			if (vertices[i].z > settings.scanMaxZ || vertices[i].z <= settings.scanMinZ)
-//				continue;
-//			pc += renderPoint(vertices[i], tex_coords[i]);
-//		}
-//		totalPointCount += pc;
-//	}
+	if (clippedVertices.size() < count) {
+		clippedVertices.resize(count);
+		clippedTexCoords.resize(count);
+	}
+	//Method 1: Linear for-loop (on the CPU) --> 7.1/8.0 fps on 33% battery
+	//Method 2: Using OpenMP to try to parallelise the loop --> 8.0/9.1 fps on 33% battery
+	//          (abandoned: glVertex calls can't be issued from worker threads)
+	//Method 3: SIMD stream compaction (SSE/AVX2) into dense arrays, then the scene's batch kernel
+	//Method 4: Method 3 on chunks by all cores, merged in the sequential order, the GL thread only uploads
+	//          (the index of a point in the compacted batch is its rank, Tron sweeps over it without a running counter)
+	size_t clippedCount = compactScanRangeParallel(vertices, tex_coords, count, range,
+		clippedVertices.data(), clippedTexCoords.data(), compactionScratch);
 
-	glEnd();
-	return totalPointCount;
+	pointBuffer.clear(2 * clippedCount);	// IBC emits up to two points per input point
+	renderBatch(clippedVertices.data(), clippedTexCoords.data(), clippedCount, pointBuffer);
+	return (int)clippedCount;
 }
 
-int MRScene::renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+template<bool Clip>
+int MRScene::renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
 {
 	// upload the point and texture coordinates only for points we have depth data for
-	glVertex3fv(vertex);
-	glTexCoord2fv(tex_coord);
-	return 1;
+	return (int)clipAndEmit<Clip>(vertices, tex_coords, count, range, EmitPoint{ out });
+}
+
+int MRScene::renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out)
+{
+	// the batch is dense and within range already, the points are drawn as they are: copied at once
+	out.add(vertices, tex_coords, count);
+	return (int)count;
+}
+
+int MRScene::clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	return renderKernel<true>(vertices, tex_coords, count, range, out);
 }
 
 void MRScene::activate()
 {
 	state = 0;
-	animStartMillis = GetTickCount();
+	renderedCloud = 0;
+	animStartMillis = currentMillis();
 }
 
 bool MRScene::action()
@@ -100,20 +151,46 @@ MRSceneSetup::~MRSceneSetup()
 {
 }
 
-int MRSceneSetup::renderPointCloud(rs2::points points)
+int MRSceneSetup::renderPointCloud(PointCloud points, unsigned long cloud)
 {
-	memset(nrPointsPerZ, 0, sizeof(nrPointsPerZ));
-
-	auto vertices = points.get_vertices();              // get vertices
-	for (unsigned int i = 0; i < points.size(); i++)
+	if (settings.show_histogram && cloud != histogramCloud && points.histogram)
 	{
-		int z = (int)(vertices[i].z * 100.f);
-		if (z > 0 && z < 1000) {
-			nrPointsPerZ[z]++;
+		// counted by the fused pass over the raw depth
+		memcpy(nrPointsPerZ, points.histogram, sizeof(nrPointsPerZ));
+		histogramCloud = cloud;
+	}
+	else if (settings.show_histogram && cloud != histogramCloud && !points.clipped)
+	{
+		memset(nrPointsPerZ, 0, sizeof(nrPointsPerZ));
+
+		auto vertices = points.vertices;
+		for (size_t i = 0; i < points.count; i++)
+		{
+			int z = (int)(vertices[i].z * 100.f);
+			if (z > 0 && z < 1000) {
+				nrPointsPerZ[z]++;
+			}
 		}
+		histogramCloud = cloud;
 	}
 
-	int pc = MRScene::renderPointCloud(points);
+	int pc = MRScene::renderPointCloud(points, cloud);
+
+	glDrawGizmo();
+	return pc;
+}
+
+int MRSceneSetup::renderDepthCloud(GlDepthCloud& depthCloud, rs2::depth_frame depth, unsigned long cloud)
+{
+	if (settings.show_histogram && cloud != histogramCloud)
+	{
+		// the same histogram from the raw depth, there are no points on the CPU
+		scanDepth(reinterpret_cast<const uint16_t*>(depth.get_data()), depth.get_stride_in_bytes(), depth.get_width(), depth.get_height(),
+			depthCloud.getDepthScale(), ScanRange{}, nullptr, nrPointsPerZ, depthScanScratch);
+		histogramCloud = cloud;
+	}
+
+	int pc = MRScene::renderDepthCloud(depthCloud, depth, cloud);
 
 	glDrawGizmo();
 	return pc;
@@ -122,18 +199,25 @@ int MRSceneSetup::renderPointCloud(rs2::points points)
 void MRSceneSetup::renderImgUI(float window_w, float window_h, rs2::depth_frame depth, rs2::video_frame color)
 {
 	// Using ImGui library to provide a slide controller to select the depth clipping distance
-	uiDrawZHist({ 5.f, 0, window_w, window_h }, settings.scanMaxZ);
+	if (settings.show_histogram)
+		uiDrawZHist({ 5.f, 0, window_w, window_h }, settings.scanMaxZ);
 	uiDrawSlider({ 0.f, 0, window_w, window_h }, settings.scanMaxZ);
 
 	// It also renders the depth frame, as a picture-in-picture
-	// Calculating the position to place the depth frame in the window
-	rect pip_stream{ 0, 0, window_w / 5, window_h / 5 };
-	pip_stream = pip_stream.adjust_ratio({ static_cast<float>(depth.get_width()),static_cast<float>(depth.get_height()) });
-	pip_stream.x = window_w - pip_stream.w - (std::max(window_w, window_h) / 25);
-	pip_stream.y = (std::max(window_w, window_h) / 25);
-	// Render depth (as picture in pipcture)
-	depthImage.upload(depthImageColorizer.process(depth));
-	depthImage.show(pip_stream);
+	if (settings.show_pip)
+	{
+		// Calculating the position to place the depth frame in the window
+		rect pip_stream{ 0, 0, window_w / 5, window_h / 5 };
+		pip_stream = pip_stream.adjust_ratio({ static_cast<float>(depth.get_width()),static_cast<float>(depth.get_height()) });
+		pip_stream.x = window_w - pip_stream.w - (std::max(window_w, window_h) / 25);
+		pip_stream.y = (std::max(window_w, window_h) / 25);
+		// Render depth (as picture in pipcture)
+		if (depth.get_frame_number() != depthImageFrame) {
+			depthImage.upload(depthImageColorizer.process(depth));
+			depthImageFrame = depth.get_frame_number();
+		}
+		depthImage.show(pip_stream);
+	}
 
 	MRScene::renderImgUI(window_w, window_h, depth, color);
 }
@@ -141,6 +225,7 @@ void MRSceneSetup::renderImgUI(float window_w, float window_h, rs2::depth_frame
 
 void MRSceneSetup::glDrawGizmo()
 {
+	GlTimerScope gpuTimer(EMRStage::GPU_GIZMO);
 	glLineWidth(2.5);
 
 	// x-axis
@@ -261,81 +346,180 @@ void MRSceneSetup::uiDrawZHist(rect location, float& clipping_dist)
 
 /////////////////////////////////////////////////////////////////
 MRSceneSnapshot::MRSceneSnapshot(MRSettings& settings) : MRScene(settings) {
-	snapshot = NULL;
-	snaphotIndex = 0;
 }
 
 MRSceneSnapshot::~MRSceneSnapshot()
 {
-	if (snapshot) {
-		delete snapshot;
-		snapshot = NULL;
-	}
 }
 
-int MRSceneSnapshot::renderPointCloud(rs2::points points)
+int MRSceneSnapshot::renderPointCloud(PointCloud points, unsigned long cloud)
 {
 	if (takeSnapshot)
 	{
-		if (snapshot) {
-			takeSnapshot = false;
-			delete snapshot;
-			snapshot = NULL;
-		}
-		else
-		{
-			snapshot = new TPoint[points.size()];
+		// room for all points, the kernel compacts those within range
+		if (captureVertices.size() < points.count) {
+			captureVertices.resize(points.count);
+			captureTexCoords.resize(points.count);
+			captureColors.resize(points.count);
 		}
-		snaphotIndex = 0;
+		captureCount = 0;
 	}
 
-	int pc = MRScene::renderPointCloud(points);
+	int pc = MRScene::renderPointCloud(points, cloud);
 
 	if (takeSnapshot)
 	{
-		snapshot[pc].v.z = 0;
+		// the color of the pixel each point is textured with, so the snapshot shows without the color texture;
+		// grey by the distance without color
+		const bool colored = settings.colored && colorImage.data;
+		if (colored) {
+			sampleColors(captureTexCoords.data(), captureCount, colorImage, settings.snapshot_bilinear ? SAMPLE_BILINEAR : SAMPLE_NEAREST,
+				reinterpret_cast<uint8_t*>(captureColors.data()));
+		}
+		else {
+			const float maxZ = settings.scanMaxZ;
+			for (size_t i = 0; i < captureCount; i++) {
+				uint8_t c = (uint8_t)((maxZ - captureVertices[i].z) / maxZ * 255.f + 0.5f);
+				captureColors[i] = { c, c, c };
+			}
+		}
+
+		// uploaded once, exactly sized
+		snapshots.setBudget(settings.snapshot_slots, (size_t)settings.snapshot_budget_mb << 20);
+		bool added = snapshots.add(captureVertices.data(), captureColors.data(), captureCount);
+		std::cout << "snapshot: " << captureCount << (colored ? " colored" : " grey") << " points" << (added ? "" : " exceed the budget")
+			<< ", " << snapshots.size() << " of " << settings.snapshot_slots << " slots, "
+			<< (snapshots.bytes() >> 20) << " of " << settings.snapshot_budget_mb << " MB" << std::endl;
+		if (settings.save_snapshots && !directory.empty() && captureCount) {
+			std::string path = directory + "/" + snapshotFileName();
+			saver.save(path, captureVertices.data(), captureTexCoords.data(),
+				reinterpret_cast<const uint8_t*>(captureColors.data()), captureCount, intrinsics);
+			std::cout << "snapshot: saving " << path << std::endl;
+		}
 		takeSnapshot = false;
 	}
 
-	// draw points from snapshot
-	if (snapshot)
+	return pc + snapshots.draw();
+}
+
+int MRSceneSnapshot::renderDepthCloud(GlDepthCloud& depthCloud, rs2::depth_frame depth, unsigned long cloud)
+{
+	int pc = MRScene::renderDepthCloud(depthCloud, depth, cloud);
+	return pc + snapshots.draw();
+}
+
+// effect: draw the point and keep it in the snapshot, colored when the capture is complete
+struct SnapshotEffect
+{
+	GlPointBuffer& out;
+	rs2::vertex* vertices;
+	rs2::texture_coordinate* tex_coords;
+
+	void operator()(size_t rank, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
 	{
-		glBegin(GL_POINTS);
-		snaphotIndex = 0;
-		while (snapshot[snaphotIndex].v.z)
-		{
-			float c = (settings.scanMaxZ - snapshot[snaphotIndex].v.z) / settings.scanMaxZ;
-			glColor3f(c, c, c);
-			glVertex3fv(snapshot[snaphotIndex].v);
-			//glTexCoord2fv(snapshot[i].t);
-			snaphotIndex++;
-		}
-		glEnd();
-		return pc + snaphotIndex;
+		out.add(vertex, tex_coord);
+		vertices[rank] = vertex;
+		tex_coords[rank] = tex_coord;
 	}
-	return pc;
+};
+
+template<bool Clip>
+int MRSceneSnapshot::renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	if (!takeSnapshot)
+		return (int)clipAndEmit<Clip>(vertices, tex_coords, count, range, EmitPoint{ out });
+
+	size_t pc = clipAndEmit<Clip>(vertices, tex_coords, count, range,
+		SnapshotEffect{ out, captureVertices.data() + captureCount, captureTexCoords.data() + captureCount });
+	captureCount += pc;
+	return (int)pc;
 }
 
-int MRSceneSnapshot::renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+int MRSceneSnapshot::renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out)
 {
-	int nr = MRScene::renderPoint(vertex, tex_coord);
+	out.add(vertices, tex_coords, count);
 	if (takeSnapshot) {
-		snapshot[snaphotIndex].v = vertex;
-		//unsigned int c = 0;
-		//glReadPixels(tex_coords[i].u, tex_coords[i].v, 1, 1, GL_RGB, GL_UNSIGNED_INT, &c);
-		//snapshot[pointCount].c = c;
-		snaphotIndex++;
+		std::copy(vertices, vertices + count, captureVertices.data() + captureCount);
+		std::copy(tex_coords, tex_coords + count, captureTexCoords.data() + captureCount);
+		captureCount += count;
 	}
-	return nr;
+	return (int)count;
+}
+
+int MRSceneSnapshot::clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	return renderKernel<true>(vertices, tex_coords, count, range, out);
 }
 
 bool MRSceneSnapshot::action()
 {
 	takeSnapshot = true;
-	PlaySound("camera.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC);
+	playSound("camera.wav");
 	return true;
 }
 
+void MRSceneSnapshot::clearSnapshots()
+{
+	snapshots.clear();
+	browsed = -1;
+	std::cout << "snapshot: cleared" << std::endl;
+}
+
+void MRSceneSnapshot::setColorFrame(rs2::video_frame color)
+{
+	// the formats of GlTexture, others leave the snapshots grey
+	colorFrame = color;
+	colorImage = ColorImage();
+	if (!color)
+		return;
+	rs2_format format = color.get_profile().format();
+	if (format != RS2_FORMAT_RGB8 && format != RS2_FORMAT_RGBA8 && format != RS2_FORMAT_Y8)
+		return;
+	colorImage.data = static_cast<const uint8_t*>(color.get_data());
+	colorImage.width = color.get_width();
+	colorImage.height = color.get_height();
+	colorImage.strideBytes = color.get_stride_in_bytes();
+	colorImage.bytesPerPixel = color.get_bytes_per_pixel();
+}
+
+void MRSceneSnapshot::setDirectory(const std::string& directory)
+{
+	this->directory = directory;
+	if (!createSnapshotDirectory(directory)) {
+		std::cerr << "snapshot: cannot create " << directory << ", the snapshots are not saved" << std::endl;
+		this->directory.clear();
+	}
+}
+
+void MRSceneSnapshot::browseSnapshots(int step)
+{
+	// listed again every time, so the files saved meanwhile are included
+	std::vector<std::string> files = listSnapshotFiles(directory);
+	if (directory.empty() || files.empty()) {
+		std::cout << "snapshot: no files to browse" << std::endl;
+		return;
+	}
+	const int n = (int)files.size();
+	browsed = (browsed < 0) ? (step < 0 ? n - 1 : 0) : (((browsed + step) % n) + n) % n;
+
+	// the GPU copies the arrays straight from the mapped pages, the mapping is released right after
+	MRMappedSnapshot file;
+	if (!file.open(directory + "/" + files[browsed]))
+		return;
+	float origin[3] = {};
+	float scale = 1.0f;
+	if (file.isQuantized()) {
+		file.origin(origin);
+		scale = file.header().quantization;
+	}
+	snapshots.clear();
+	snapshots.setBudget(settings.snapshot_slots, (size_t)settings.snapshot_budget_mb << 20);
+	bool added = snapshots.add(file.positions(), file.isQuantized() ? GL_SHORT : GL_FLOAT, origin, scale,
+		reinterpret_cast<const GlSnapshotStore::Color*>(file.colors()), file.count());
+	std::cout << "snapshot: " << browsed + 1 << " of " << n << " " << files[browsed] << ", " << file.count() << " points"
+		<< (added ? "" : " exceed the budget") << std::endl;
+}
+
 
 /////////////////////////////////////////////////////////////////
 MRSceneIBC::MRSceneIBC(MRSettings& settings) : MRScene(settings)
@@ -355,27 +539,50 @@ void MRSceneIBC::preRenderPointCloud()
 {
 	MRScene::preRenderPointCloud();
 	iceAnimDY = (float)(animAgeMillis) / 1000.0f * pow(iceAnimSpeed, 1.0f + animAgeMillis / 10000.0f*iceAnimAccel);
+	frame++;
 }
 
-int MRSceneIBC::renderPointCloud(rs2::points points)
+int MRSceneIBC::renderPointCloud(PointCloud points, unsigned long cloud)
 {
-	return MRScene::renderPointCloud(points);
+	return MRScene::renderPointCloud(points, cloud);
 }
 
-int MRSceneIBC::renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+// effect: ice-water falling down, covering the real world up to its current height
+struct IceWaterEffect
 {
-	rs2::vertex realWorldPoint = vertex;
-	rs2::vertex icePoint = vertex;
-	icePoint.y = iceStartY - iceAnimDY + std::rand() / ((RAND_MAX + 1u) / (10.0f + animAgeMillis / 2.0f));
+	GlPointBuffer& out;
+	float iceY;				// m, upper end of the falling water
+	float iceHeight;		// m, the drops are spread over
+	PointRandom random;
 
-	if (icePoint.y <= realWorldPoint.y)
-		realWorldPoint.y = icePoint.y;
-	glVertex3fv(realWorldPoint);
-	glTexCoord2fv(tex_coord);
+	void operator()(size_t rank, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		rs2::vertex realWorldPoint = vertex;
+		rs2::vertex icePoint = vertex;
+		icePoint.y = iceY + random.uniform(rank) * iceHeight;
+
+		if (icePoint.y <= realWorldPoint.y)
+			realWorldPoint.y = icePoint.y;
+		out.add(realWorldPoint, tex_coord);
+		out.add(icePoint, tex_coord);
+	}
+};
+
+template<bool Clip>
+int MRSceneIBC::renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	IceWaterEffect effect{ out, iceStartY - iceAnimDY, 10.0f + animAgeMillis / 2.0f, PointRandom(settings.random_seed, frame) };
+	return (int)clipAndEmit<Clip>(vertices, tex_coords, count, range, effect);
+}
 
-	glVertex3fv(icePoint);
-	glTexCoord2fv(tex_coord);
-	return 2;
+int MRSceneIBC::renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out)
+{
+	return renderKernel<false>(vertices, tex_coords, count, {}, out);
+}
+
+int MRSceneIBC::clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	return renderKernel<true>(vertices, tex_coords, count, range, out);
 }
 
 bool MRSceneIBC::action()
@@ -385,12 +592,12 @@ bool MRSceneIBC::action()
 	case 1:  // water
 		animStartMillis = 0;
 		iceAnimDY = 0.0f;
-		PlaySound("water.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC | SND_LOOP);
+		playSound("water.wav", true);
 		break;
 	case 2:  // splash
-		animStartMillis = GetTickCount();
+		animStartMillis = currentMillis();
 		iceAnimDY = 0.0f;
-		PlaySound("splash.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC);
+		playSound("splash.wav");
 		break;
 	case 0:  // no animation / reset
 	default:
@@ -416,8 +623,8 @@ void MRSceneIBC::decWaterYPosition()
 /////////////////////////////////////////////////////////////////
 MRSceneTron::MRSceneTron(MRSettings& settings) : MRScene(settings)
 {
+	tronLaserPoint = rs2::vertex{ 0.0f, 0.0f, 0.0f };
 	laserPointIndex = 0;
-	currentPointIndex = 0;
 	lastPointCount = 0;
 }
 
@@ -425,30 +632,9 @@ MRSceneTron::~MRSceneTron()
 {
 }
 
-void MRSceneTron::preRenderPointCloud()
+int MRSceneTron::renderPointCloud(PointCloud points, unsigned long cloud)
 {
-	MRScene::preRenderPointCloud();
-	laserPointIndex = lastPointCount * animAgeMillis / 100 / 100;	// total animation lasts 10s (ms / 1000 * 10)
-																		// -->0..100% of pointCount
-}
-
-int MRSceneTron::renderPointCloud(rs2::points points)
-{
-	auto vertices = points.get_vertices();              // get vertices
-	auto tex_coords = points.get_texture_coordinates(); // and texture coordinates
-
-	currentPointIndex = 0;
-	glBegin(GL_POINTS);
-	// ATTENTION: due to usage of lastPointCount and laserPointIndex the following for-loop must be executed in linear mode
-	// and can't paralellized by OpenMP
-	for (unsigned int i = 0; i < points.size(); i++)
-	{
-		if (vertices[i].z > settings.scanMaxZ || vertices[i].z <= settings.scanMinZ)
-			continue;
-		currentPointIndex += renderPoint(vertices[i], tex_coords[i]);
-	}
-	glEnd();
-	lastPointCount = currentPointIndex;
+	MRScene::renderPointCloud(points, cloud);
 
 	if (state == 2 && animAgeMillis > 10000)
 		state = 0;	// reset to the beginning
@@ -465,35 +651,72 @@ int MRSceneTron::renderPointCloud(rs2::points points)
 	return lastPointCount;
 }
 
-int MRSceneTron::renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+// the laser sweeps over the points in the order of their rank within the scan range in 10s (0..100% of the points)
+static size_t laserRank(size_t pointCount, long animAgeMillis)
 {
-	if (animAgeMillis > 0) {
-		if (state == 1 /* disappear */)
-		{
-			if (currentPointIndex > laserPointIndex) {
-				glVertex3fv(vertex);
-				glTexCoord2fv(tex_coord);
-			}
-			else if (currentPointIndex == laserPointIndex) {
-				tronLaserPoint = vertex;
-			}
+	return (size_t)((uint64_t)pointCount * animAgeMillis / 10000);
+}
+
+// effect: points vanish behind the laser (Appear=false) or show up in front of it (Appear=true)
+template<bool Appear>
+struct LaserSweepEffect
+{
+	GlPointBuffer& out;
+	size_t laserPointIndex;
+	rs2::vertex& laserPoint;
+
+	void operator()(size_t rank, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+	{
+		if (Appear ? (rank < laserPointIndex) : (rank > laserPointIndex))
+			out.add(vertex, tex_coord);
+		else if (rank == laserPointIndex)
+			laserPoint = vertex;
+	}
+};
+
+template<bool Clip>
+int MRSceneTron::renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	size_t pc;
+	if (animAgeMillis <= 0)
+		pc = clipAndEmit<Clip>(vertices, tex_coords, count, range, SkipPoint());
+	else if (state == 0)
+		pc = clipAndEmit<Clip>(vertices, tex_coords, count, range, EmitPoint{ out });
+	else if (Clip) {
+		// the ranks are those of the compaction, then the same as on a batch
+		if (clippedVertices.size() < count) {
+			clippedVertices.resize(count);
+			clippedTexCoords.resize(count);
 		}
-		else if (state == 2 /* appear */)
-		{
-			if (currentPointIndex < laserPointIndex) {
-				glVertex3fv(vertex);
-				glTexCoord2fv(tex_coord);
-			}
-			else if (currentPointIndex == laserPointIndex) {
-				tronLaserPoint = vertex;
-			}
+		size_t clippedCount = compactScanRange(vertices, tex_coords, count, range, clippedVertices.data(), clippedTexCoords.data());
+		return renderKernel<false>(clippedVertices.data(), clippedTexCoords.data(), clippedCount, {}, out);
+	}
+	else {
+		// the batch is compacted, the rank of a point is its index (the prefix sum of the compaction),
+		// so the visible points are one range in front of or behind the laser point
+		pc = count;
+		laserPointIndex = laserRank(pc, animAgeMillis);
+		if (laserPointIndex < count)
+			tronLaserPoint = vertices[laserPointIndex];
+		if (state == 1 /* disappear */) {
+			size_t first = std::min(laserPointIndex + 1, count);
+			out.add(vertices + first, tex_coords + first, count - first);
 		}
 		else
-		{
-			MRScene::renderPoint(vertex, tex_coord);
-		}
+			out.add(vertices, tex_coords, std::min(laserPointIndex, count));
 	}
-	return 1;
+	lastPointCount = (int)pc;
+	return lastPointCount;
+}
+
+int MRSceneTron::renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out)
+{
+	return renderKernel<false>(vertices, tex_coords, count, {}, out);
+}
+
+int MRSceneTron::clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	return renderKernel<true>(vertices, tex_coords, count, range, out);
 }
 
 bool MRSceneTron::action()
@@ -501,12 +724,12 @@ bool MRSceneTron::action()
 	state++;
 	switch (state) {
 	case 1:  // laser animation: disappearing
-		animStartMillis = GetTickCount();
-		PlaySound("laser.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC);
+		animStartMillis = currentMillis();
+		playSound("laser.wav");
 		break;
 	case 2:  // laser animation: appearing
-		animStartMillis = GetTickCount();
-		PlaySound("laser.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC);
+		animStartMillis = currentMillis();
+		playSound("laser.wav");
 		break;
 	case 0:  // no animation, reset
 	default:
@@ -539,23 +762,40 @@ void MRSceneStartrek::preRenderPointCloud()
 		rel = (float)(1.f - anim) ;
 	else if (state == 2)
 		rel = (float)(anim);
-	limit = (int)((float)RAND_MAX * rel * rel * rel);
+	limit = PointRandom::threshold(rel * rel * rel);
+	frame++;
 }
 
-int MRSceneStartrek::renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
+// effect: each point shows up with a probability of limit/2^32
+struct BeamEffect
 {
-	if (animAgeMillis > 0) {
-		if (((state == 1 /* disappear */ || state == 2 /* appear */) && (std::rand() < limit))
-			|| (state == 0)) {
-			glVertex3fv(vertex);
-			glTexCoord2fv(tex_coord);
-		}
-	}
-	else
+	GlPointBuffer& out;
+	uint32_t limit;
+	PointRandom random;
+
+	void operator()(size_t rank, const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord)
 	{
-		MRScene::renderPoint(vertex, tex_coord);
+		if (random.chance(rank, limit))
+			out.add(vertex, tex_coord);
 	}
-	return 1;
+};
+
+template<bool Clip>
+int MRSceneStartrek::renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	if (animAgeMillis > 0 && (state == 1 /* disappear */ || state == 2 /* appear */))
+		return (int)clipAndEmit<Clip>(vertices, tex_coords, count, range, BeamEffect{ out, limit, PointRandom(settings.random_seed, frame) });
+	return (int)clipAndEmit<Clip>(vertices, tex_coords, count, range, EmitPoint{ out });
+}
+
+int MRSceneStartrek::renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out)
+{
+	return renderKernel<false>(vertices, tex_coords, count, {}, out);
+}
+
+int MRSceneStartrek::clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out)
+{
+	return renderKernel<true>(vertices, tex_coords, count, range, out);
 }
 
 bool MRSceneStartrek::action()
@@ -563,12 +803,12 @@ bool MRSceneStartrek::action()
 	state++;
 	switch (state) {
 	case 1:  // beam down
-		animStartMillis = GetTickCount();
-		PlaySound("startrek.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC);
+		animStartMillis = currentMillis();
+		playSound("startrek.wav");
 		break;
 	case 2:  // beam up
-		animStartMillis = GetTickCount();
-		PlaySound("startrek.wav", GetModuleHandle(NULL), SND_FILENAME | SND_ASYNC);
+		animStartMillis = currentMillis();
+		playSound("startrek.wav");
 		break;
 	case 0:  // no animation, reset
 	default:
@@ -5,6 +5,11 @@
 
 #include "GlTypes.h"
 #include "GlWindow.h"
+#include "GlPointBuffer.h"
+#include "GlDepthCloud.h"
+#include "GlSnapshotStore.h"
+#include "MRKernels.h"
+#include "MRSnapshotFile.h"
 
 #include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
 
@@ -26,8 +31,22 @@ public:
 	float scanMinZ;		// m
 	float scanMaxZ;		// m
 	bool auto_rotation;
+	bool use_vbo;		// draw the pointcloud from a vertex buffer, otherwise with glBegin/glVertex from the same buffer
+	bool governor;		// adapt density, point size and optional stages to hold target_fps
+	int target_fps;
+	float point_size;	// scales the default point size
+	bool show_histogram;	// optional stages of the setup scene
+	bool show_pip;
+	bool gpu_deprojection;	// build the points of plain scenes from the raw depth on the GPU
+	bool simd_deprojection;	// build the points on the CPU with MRDeprojector, otherwise with rs2::pointcloud
+	int snapshot_slots;		// snapshots kept on the GPU, the oldest is dropped
+	int snapshot_budget_mb;	// GPU memory for them
+	bool save_snapshots;	// write every snapshot to a file, in the background
+	bool snapshot_bilinear;	// colors of the snapshots interpolated between the pixels, otherwise the nearest
+	unsigned int random_seed;	// of the random numbers of the effects, kept by reset()
 
 	MRSettings() {
+		random_seed = 0;
 		reset();
 	}
 
@@ -37,6 +56,18 @@ public:
 		scanMinZ = 0.0f;		// m
 		scanMaxZ = 1.0f;		// m default=1.73f
 		auto_rotation = true;
+		use_vbo = true;
+		governor = false;
+		target_fps = 30;
+		point_size = 1.0f;
+		show_histogram = true;
+		show_pip = true;
+		gpu_deprojection = false;
+		simd_deprojection = true;
+		snapshot_slots = 8;
+		snapshot_budget_mb = 64;
+		save_snapshots = true;
+		snapshot_bilinear = true;
 	}
 };
 
@@ -49,6 +80,21 @@ protected:
 	long animStartMillis = 0;
 	long animAgeMillis = 0;
 
+	GlPointBuffer pointBuffer;	// points emitted by the scene for the current frame
+	std::vector<rs2::vertex> clippedVertices;					// points within the scan range
+	std::vector<rs2::texture_coordinate> clippedTexCoords;
+	CompactionScratch compactionScratch;
+
+	unsigned long renderedCloud = 0;	// serial of the cloud held in pointBuffer, 0..none
+	ScanRange renderedRange{};
+	int renderedState = 0;
+	int renderedPointCount = 0;
+
+	// true while the emitted points change over time, so a retained cloud is processed again on every render
+	virtual bool isAnimated() { return false; }
+	// clock of the animations in ms, steady_clock; fixed by the benchmark so the states are reproducible
+	virtual long currentMillis() const;
+
 public:
 	MRScene(MRSettings& settings);
 	virtual ~MRScene() {};
@@ -57,10 +103,28 @@ public:
 
 	// rendering:
 	virtual void preRenderPointCloud();
-	virtual int renderPointCloud(rs2::points points);
-	virtual int renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord);
+	// cloud is the serial of the points, the same serial re-draws the points still on the GPU
+	virtual int renderPointCloud(PointCloud points, unsigned long cloud);
 	virtual void renderImgUI(float window_w, float window_h, rs2::depth_frame depth, rs2::video_frame color) {}
 
+	// true if the scene shows the points as they are, so they can be deprojected on the GPU
+	virtual bool isPlain() { return !isAnimated(); }
+	// draws the depth uploaded to depthCloud instead of the points, for plain scenes
+	virtual int renderDepthCloud(GlDepthCloud& depthCloud, rs2::depth_frame depth, unsigned long cloud);
+
+	// point processing (no OpenGL calls), returning the number of points within the scan range:
+	int processPointCloud(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count);
+	// emits the effect of the scene for a batch of points which are already within the scan range
+	virtual int renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out);
+	// same as renderBatch, but drops the points outside of the scan range on the way
+	virtual int clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
+
+private:
+	template<bool Clip>
+	int renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
+
+public:
+
 	// interaction:
 	virtual void activate();
 	virtual bool action();	// returns false if scene ended (return to default-scene)
@@ -68,17 +132,28 @@ public:
 
 
 /////////////////////////////////////////////////////////////////
-typedef struct {
-	rs2::vertex v;	// vertex x/y/z-coordinates
-	int c;		// color
-} TPoint;
-
 class MRSceneSnapshot : public MRScene
 {
 private:
 	bool takeSnapshot = false;
-	TPoint* snapshot = NULL;
-	unsigned int snaphotIndex = 0;
+	GlSnapshotStore snapshots;		// frozen on the GPU, drawn every frame
+	std::vector<rs2::vertex> captureVertices;			// the snapshot being taken, dense
+	std::vector<rs2::texture_coordinate> captureTexCoords;
+	std::vector<GlSnapshotStore::Color> captureColors;
+	size_t captureCount = 0;
+	rs2_intrinsics intrinsics = {};	// of the depth camera, stored with the files
+	rs2::frame colorFrame;			// the frame of colorImage, kept while it is sampled
+	ColorImage colorImage;			// of the points, to sample their colors, no data..grey
+
+	MRSnapshotSaver saver;			// writes the snapshots taken to directory
+	std::string directory;			// of the snapshot files, empty..not saved
+	int browsed = -1;				// index of the file shown among those in directory, -1..none
+
+	template<bool Clip>
+	int renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
+
+protected:
+	virtual bool isAnimated() { return takeSnapshot; }
 
 public:
 	MRSceneSnapshot(MRSettings& settings);
@@ -86,10 +161,21 @@ public:
 
 	virtual EMRSceneType type() { return EMRSceneType::SNAP; }
 
-	virtual int renderPointCloud(rs2::points points);
-	virtual int renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord);
+	virtual int renderPointCloud(PointCloud points, unsigned long cloud);
+	virtual int renderDepthCloud(GlDepthCloud& depthCloud, rs2::depth_frame depth, unsigned long cloud);
+	virtual int renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out);
+	virtual int clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
 
 	virtual bool action();	// returns false if scene ended (return to default-scene)
+	void clearSnapshots();
+
+	// creates the directory for the snapshot files, if it does not exist yet
+	void setDirectory(const std::string& directory);
+	void setCamera(const rs2_intrinsics& depthIntrinsics) { intrinsics = depthIntrinsics; }
+	// the color frame the points of the next snapshot are mapped to
+	void setColorFrame(rs2::video_frame color);
+	// shows the stored snapshot step files after (or before) the one shown, mapped and uploaded from the file
+	void browseSnapshots(int step);
 };
 
 
@@ -99,7 +185,10 @@ class MRSceneSetup : public MRScene
 private:
 	GlTexture depthImage;                   // Helper for renderig images
 	rs2::colorizer depthImageColorizer;     // Helper to colorize depth images
-	int nrPointsPerZ[1000];				    // counts points per Z-coordinate (centimeter)
+	int nrPointsPerZ[DEPTH_HISTOGRAM_BINS];	// counts points per Z-coordinate (centimeter)
+	DepthScanScratch depthScanScratch;		// to count them from the raw depth
+	unsigned long histogramCloud = 0;		// serial of the cloud counted in nrPointsPerZ
+	unsigned long long depthImageFrame = 0;	// frame-number of the depth frame in depthImage
 
 public:
 	MRSceneSetup(MRSettings& settings);
@@ -109,7 +198,8 @@ public:
 	static const float SLIDER_WINDOW_WIDTH;
 	static const int SLIDER_PIXELS_TO_BOTTOM;
 
-	virtual int renderPointCloud(rs2::points points);
+	virtual int renderPointCloud(PointCloud points, unsigned long cloud);
+	virtual int renderDepthCloud(GlDepthCloud& depthCloud, rs2::depth_frame depth, unsigned long cloud);
 	virtual void renderImgUI(float window_w, float window_h, rs2::depth_frame depth, rs2::video_frame color);
 
 private:
@@ -132,6 +222,13 @@ private:
 	float iceAnimDY = 0.0f;			// m
 	float iceAnimSpeed = 0.750f;    // m/s
 	float iceAnimAccel = 0.002f;	// m/s
+	uint32_t frame = 0;				// counts the renders, the random numbers differ per frame
+
+	template<bool Clip>
+	int renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
+
+protected:
+	virtual bool isAnimated() { return true; }
 
 public:
 	MRSceneIBC(MRSettings& settings);
@@ -140,8 +237,9 @@ public:
 	virtual EMRSceneType type() { return EMRSceneType::IBC; }
 
 	virtual void preRenderPointCloud();
-	virtual int renderPointCloud(rs2::points points);
-	virtual int renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord);
+	virtual int renderPointCloud(PointCloud points, unsigned long cloud);
+	virtual int renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out);
+	virtual int clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
 
 	virtual bool action();	// returns false if scene ended (return to default-scene)
 
@@ -154,19 +252,26 @@ class MRSceneTron : public MRScene
 {
 private:
 	rs2::vertex tronLaserPoint;
-	unsigned int currentPointIndex;
-	unsigned int laserPointIndex;
+	size_t laserPointIndex;		// rank of the point the laser hits, among the points within the scan range
 	int lastPointCount;
 
+	template<bool Clip>
+	int renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
+
+protected:
+	virtual bool isAnimated() { return state != 0; }
+
 public:
 	MRSceneTron(MRSettings& settings);
 	virtual ~MRSceneTron();
 
 	virtual EMRSceneType type() { return EMRSceneType::TRON; }
 
-	virtual void preRenderPointCloud();
-	virtual int renderPointCloud(rs2::points points);
-	virtual int renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord);
+	const rs2::vertex& laserPoint() const { return tronLaserPoint; }
+
+	virtual int renderPointCloud(PointCloud points, unsigned long cloud);
+	virtual int renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out);
+	virtual int clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
 
 	virtual bool action();	// returns false if scene ended (return to default-scene)
 };
@@ -174,7 +279,14 @@ public:
 class MRSceneStartrek : public MRScene
 {
 private:
-	int limit;
+	uint32_t limit;		// a point shows up if its random bits are below, see PointRandom::chance()
+	uint32_t frame = 0;	// counts the renders, the random numbers differ per frame
+
+	template<bool Clip>
+	int renderKernel(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
+
+protected:
+	virtual bool isAnimated() { return state != 0; }
 
 public:
 	MRSceneStartrek(MRSettings& settings);
@@ -183,7 +295,8 @@ public:
 	virtual EMRSceneType type() { return EMRSceneType::STARTREK; }
 
 	virtual void preRenderPointCloud();
-	virtual int renderPoint(const rs2::vertex& vertex, const rs2::texture_coordinate& tex_coord);
+	virtual int renderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, GlPointBuffer& out);
+	virtual int clipAndRenderBatch(const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords, size_t count, ScanRange range, GlPointBuffer& out);
 
 	virtual bool action();	// returns false if scene ended (return to default-scene)
 };
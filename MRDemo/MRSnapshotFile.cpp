@@ -0,0 +1,337 @@
+#include "MRSnapshotFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>				// CreateFileMapping(), MapViewOfFile(), FindFirstFile()
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+
+static uint64_t alignUp(uint64_t offset)
+{
+	return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+static void pad(std::ofstream& out, uint64_t& offset, uint64_t to)
+{
+	static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+	out.write(zeros, (std::streamsize)(to - offset));
+	offset = to;
+}
+
+bool writeSnapshotFile(const std::string& path, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords,
+	const uint8_t* colors, size_t count, const rs2_intrinsics& intrinsics, bool quantize)
+{
+	if (count > UINT32_MAX)
+		return false;
+
+	MRSnapshotHeader header = {};
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.headerBytes = sizeof(MRSnapshotHeader);
+	header.count = (uint32_t)count;
+	header.intrinsics = intrinsics;
+	header.timestamp = (uint64_t)time(nullptr);
+	for (int a = 0; a < 3; a++) {
+		header.boundsMin[a] = count ? (&vertices[0].x)[a] : 0.0f;
+		header.boundsMax[a] = header.boundsMin[a];
+	}
+	for (size_t i = 1; i < count; i++) {
+		const float* p = &vertices[i].x;
+		for (int a = 0; a < 3; a++) {
+			header.boundsMin[a] = std::min(header.boundsMin[a], p[a]);
+			header.boundsMax[a] = std::max(header.boundsMax[a], p[a]);
+		}
+	}
+
+	// one scale for all axes, so the modelview matrix stays uniform
+	std::vector<int16_t> quantized;
+	if (quantize) {
+		float extent = 0.0f;
+		for (int a = 0; a < 3; a++)
+			extent = std::max(extent, header.boundsMax[a] - header.boundsMin[a]);
+		header.quantization = extent > 0.0f ? extent / 65535.0f : 1e-6f;
+		const float inverse = 1.0f / header.quantization;
+		quantized.resize(3 * count);
+		for (size_t i = 0; i < count; i++) {
+			const float* p = &vertices[i].x;
+			for (int a = 0; a < 3; a++) {
+				float u = std::floor((p[a] - header.boundsMin[a]) * inverse + 0.5f);
+				quantized[3 * i + a] = (int16_t)((int)std::min(std::max(u, 0.0f), 65535.0f) - 32768);
+			}
+		}
+	}
+	const uint64_t positionBytes = quantize ? quantized.size() * sizeof(int16_t) : count * sizeof(rs2::vertex);
+	const uint64_t texCoordBytes = count * sizeof(rs2::texture_coordinate);
+	const uint64_t colorBytes = count * 3;
+	header.positionOffset = alignUp(sizeof(MRSnapshotHeader));
+	header.texCoordOffset = alignUp(header.positionOffset + positionBytes);
+	header.colorOffset = alignUp(header.texCoordOffset + texCoordBytes);
+	header.fileBytes = header.colorOffset + colorBytes;
+
+	// written under a temporary name, so a file listed for browsing is always complete
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		uint64_t offset = sizeof(header);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		pad(out, offset, header.positionOffset);
+		out.write(quantize ? reinterpret_cast<const char*>(quantized.data()) : reinterpret_cast<const char*>(vertices), (std::streamsize)positionBytes);
+		offset += positionBytes;
+		pad(out, offset, header.texCoordOffset);
+		out.write(reinterpret_cast<const char*>(tex_coords), (std::streamsize)texCoordBytes);
+		offset += texCoordBytes;
+		pad(out, offset, header.colorOffset);
+		out.write(reinterpret_cast<const char*>(colors), (std::streamsize)colorBytes);
+		if (!out.flush()) {
+			out.close();
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+std::vector<std::string> listSnapshotFiles(const std::string& directory)
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((directory + "\\*.mrsnap").c_str(), &found);
+	if (search != INVALID_HANDLE_VALUE) {
+		do {
+			if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				names.push_back(found.cFileName);
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+	}
+#else
+	if (DIR* dir = opendir(directory.c_str())) {
+		while (dirent* entry = readdir(dir)) {
+			std::string name = entry->d_name;
+			if (name.size() > 7 && name.compare(name.size() - 7, 7, ".mrsnap") == 0)
+				names.push_back(name);
+		}
+		closedir(dir);
+	}
+#endif
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+bool createSnapshotDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(directory.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	struct stat info;
+	return mkdir(directory.c_str(), 0755) == 0 || (stat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode));
+#endif
+}
+
+std::string snapshotFileName()
+{
+	static std::atomic<int> taken(0);
+	time_t now = time(nullptr);
+	tm local;
+#ifdef _WIN32
+	localtime_s(&local, &now);
+#else
+	localtime_r(&now, &local);
+#endif
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+	return std::string("snapshot-") + stamp + "-" + std::to_string(++taken) + ".mrsnap";
+}
+
+
+/////////////////////////////////////////////////////////////////
+bool MRMappedSnapshot::open(const std::string& path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	file = handle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MRSnapshotHeader)) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	size = (size_t)fileSize.QuadPart;
+#else
+	file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(MRSnapshotHeader)) {
+		close();
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (view != MAP_FAILED)
+		data = static_cast<const uint8_t*>(view);
+	size = (size_t)info.st_size;
+#endif
+	if (!data) {
+		close();
+		return false;
+	}
+
+	const MRSnapshotHeader& h = header();
+	const uint64_t positionBytes = (uint64_t)h.count * 3 * (h.quantization > 0.0f ? sizeof(int16_t) : sizeof(float));
+	auto fits = [&](uint64_t offset, uint64_t bytes) { return offset % SNAPSHOT_ALIGNMENT == 0 && offset <= size && bytes <= size - offset; };
+	bool valid = memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) == 0 && h.version == SNAPSHOT_VERSION
+		&& h.headerBytes >= sizeof(MRSnapshotHeader) && h.headerBytes <= h.positionOffset && h.fileBytes == size
+		&& fits(h.positionOffset, positionBytes)
+		&& fits(h.texCoordOffset, (uint64_t)h.count * sizeof(rs2::texture_coordinate))
+		&& fits(h.colorOffset, (uint64_t)h.count * 3);
+	if (!valid) {
+		std::cerr << "MRMappedSnapshot: " << path << " is not a snapshot file of version " << SNAPSHOT_VERSION << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MRMappedSnapshot::close()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	mapping = file = nullptr;
+#else
+	if (data)
+		munmap(const_cast<uint8_t*>(data), size);
+	if (file >= 0)
+		::close(file);
+	file = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void MRMappedSnapshot::origin(float origin[3]) const
+{
+	const MRSnapshotHeader& h = header();
+	for (int a = 0; a < 3; a++)
+		origin[a] = h.boundsMin[a] + 32768.0f * h.quantization;
+}
+
+rs2::vertex MRMappedSnapshot::vertex(size_t i) const
+{
+	const MRSnapshotHeader& h = header();
+	if (!isQuantized())
+		return static_cast<const rs2::vertex*>(positions())[i];
+	const int16_t* p = static_cast<const int16_t*>(positions()) + 3 * i;
+	return { h.boundsMin[0] + (p[0] + 32768) * h.quantization, h.boundsMin[1] + (p[1] + 32768) * h.quantization,
+		h.boundsMin[2] + (p[2] + 32768) * h.quantization };
+}
+
+
+/////////////////////////////////////////////////////////////////
+MRSnapshotSaver::MRSnapshotSaver()
+{
+	worker = std::thread(&MRSnapshotSaver::saveLoop, this);
+}
+
+MRSnapshotSaver::~MRSnapshotSaver()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_one();
+	if (worker.joinable())
+		worker.join();
+}
+
+void MRSnapshotSaver::save(const std::string& path, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords,
+	const uint8_t* colors, size_t count, const rs2_intrinsics& intrinsics)
+{
+	Job job;
+	job.path = path;
+	job.vertices.assign(vertices, vertices + count);
+	job.tex_coords.assign(tex_coords, tex_coords + count);
+	job.colors.assign(colors, colors + 3 * count);
+	job.intrinsics = intrinsics;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	wakeup.notify_one();
+}
+
+void MRSnapshotSaver::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return jobs.empty() && !writing; });
+}
+
+size_t MRSnapshotSaver::pending()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return jobs.size() + (writing ? 1 : 0);
+}
+
+size_t MRSnapshotSaver::saved()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return savedCount;
+}
+
+size_t MRSnapshotSaver::failed()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return failedCount;
+}
+
+void MRSnapshotSaver::saveLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wakeup.wait(lock, [this] { return stopping || !jobs.empty(); });
+		if (jobs.empty())
+			break;		// stopping, and all files are written
+		Job job = std::move(jobs.front());
+		jobs.pop_front();
+		writing = true;
+		lock.unlock();
+
+		bool written = writeSnapshotFile(job.path, job.vertices.data(), job.tex_coords.data(), job.colors.data(),
+			job.vertices.size(), job.intrinsics);
+		if (!written)
+			std::cerr << "MRSnapshotSaver: could not write " << job.path << std::endl;
+
+		lock.lock();
+		writing = false;
+		(written ? savedCount : failedCount)++;
+		if (jobs.empty())
+			idle.notify_all();
+	}
+}
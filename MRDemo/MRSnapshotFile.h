@@ -0,0 +1,142 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/////////////////////////////////////////////////////////////////
+// Binary point-cloud snapshot files (*.mrsnap)                //
+/////////////////////////////////////////////////////////////////
+// MRSnapshotHeader, then the arrays (structure of arrays), each starting at a multiple of
+// SNAPSHOT_ALIGNMENT from the start of the file:
+//   positions   count * 3 int16: (xyz - boundsMin) / quantization - 32768, rounded (GL_SHORT, as
+//               glVertexPointer() takes no unsigned types), or count * 3 float (rs2::vertex) if quantization is 0
+//   tex_coords  count * 2 float (rs2::texture_coordinate)
+//   colors      count * 3 uint8 (rgb)
+// The arrays are laid out as GlSnapshotStore uploads them, a mapped file goes to the GPU without conversion.
+// The quantized positions are scaled back by the modelview matrix, the error is at most quantization/2
+// (0.02mm for a cloud extending 2.5m).
+// All values are little-endian (x86).
+
+static const char SNAPSHOT_MAGIC[4] = { 'M', 'R', 'S', 'N' };
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const size_t SNAPSHOT_ALIGNMENT = 64;
+
+struct MRSnapshotHeader
+{
+	char magic[4];				// SNAPSHOT_MAGIC
+	uint32_t version;			// SNAPSHOT_VERSION
+	uint32_t headerBytes;		// sizeof(MRSnapshotHeader) of the writer
+	uint32_t count;				// points
+	float boundsMin[3];			// m, the origin of the quantized positions
+	float boundsMax[3];
+	float quantization;			// m per unit of the positions, 0..float positions
+	rs2_intrinsics intrinsics;	// of the depth image the points were deprojected from
+	uint64_t timestamp;			// seconds since 1970
+	uint64_t positionOffset;	// bytes from the start of the file
+	uint64_t texCoordOffset;
+	uint64_t colorOffset;
+	uint64_t fileBytes;
+};
+
+// writes a snapshot file at once, quantize stores the positions as 16 bit; false if it could not be written
+bool writeSnapshotFile(const std::string& path, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords,
+	const uint8_t* colors, size_t count, const rs2_intrinsics& intrinsics, bool quantize = true);
+
+// names of the snapshot files in the directory, sorted (the names begin with the time they were taken)
+std::vector<std::string> listSnapshotFiles(const std::string& directory);
+// creates the directory if it does not exist yet
+bool createSnapshotDirectory(const std::string& directory);
+// "snapshot-YYYYMMDD-HHMMSS-<n>.mrsnap", n counts the snapshots of this run
+std::string snapshotFileName();
+
+
+/////////////////////////////////////////////////////////////////
+// Read-only mapping of a snapshot file                        //
+/////////////////////////////////////////////////////////////////
+// The arrays point into the mapping: the pages are read on first access, nothing is copied.
+class MRMappedSnapshot
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;		// HANDLE
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+
+public:
+	MRMappedSnapshot() {}
+	MRMappedSnapshot(const MRMappedSnapshot&) = delete;
+	MRMappedSnapshot& operator=(const MRMappedSnapshot&) = delete;
+	~MRMappedSnapshot() { close(); }
+
+	// maps the file and validates the header and the array bounds
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	const MRSnapshotHeader& header() const { return *reinterpret_cast<const MRSnapshotHeader*>(data); }
+	size_t count() const { return header().count; }
+	bool isQuantized() const { return header().quantization > 0.0f; }
+	const void* positions() const { return data + header().positionOffset; }	// int16 or float xyz
+	// position = origin + quantization * stored position, for the quantized positions
+	void origin(float origin[3]) const;
+	const rs2::texture_coordinate* texCoords() const { return reinterpret_cast<const rs2::texture_coordinate*>(data + header().texCoordOffset); }
+	const uint8_t* colors() const { return data + header().colorOffset; }
+
+	// the position of point i in m, for checks and tools (the GPU dequantizes while drawing)
+	rs2::vertex vertex(size_t i) const;
+};
+
+
+/////////////////////////////////////////////////////////////////
+// Snapshot files written by a background thread               //
+/////////////////////////////////////////////////////////////////
+// save() takes copies of the arrays and returns at once, the files are written in the order they were queued.
+// The destructor writes the pending files before it returns, so no snapshot is lost when the app exits.
+class MRSnapshotSaver
+{
+	struct Job
+	{
+		std::string path;
+		std::vector<rs2::vertex> vertices;
+		std::vector<rs2::texture_coordinate> tex_coords;
+		std::vector<uint8_t> colors;
+		rs2_intrinsics intrinsics;
+	};
+	std::deque<Job> jobs;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable idle;
+	bool stopping = false;
+	bool writing = false;
+	size_t savedCount = 0;
+	size_t failedCount = 0;
+	std::thread worker;
+
+public:
+	MRSnapshotSaver();
+	MRSnapshotSaver(const MRSnapshotSaver&) = delete;
+	MRSnapshotSaver& operator=(const MRSnapshotSaver&) = delete;
+	~MRSnapshotSaver();
+
+	void save(const std::string& path, const rs2::vertex* vertices, const rs2::texture_coordinate* tex_coords,
+		const uint8_t* colors, size_t count, const rs2_intrinsics& intrinsics);
+	// blocks until the queued files are written
+	void flush();
+
+	size_t pending();
+	size_t saved();
+	size_t failed();
+
+private:
+	void saveLoop();
+};
@@ -0,0 +1,101 @@
+#include "MRStageTimings.h"
+
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+MRStageTimings::MRStageTimings()
+{
+	reset();
+}
+
+const char* MRStageTimings::name(EMRStage stage)
+{
+	switch (stage) {
+	case EMRStage::WAIT_FOR_FRAMES: return "wait_for_frames";
+	case EMRStage::DECIMATION: return "decimation";
+	case EMRStage::POINTCLOUD: return "pointcloud::calculate";
+	case EMRStage::MAP_TO: return "pointcloud::map_to";
+	case EMRStage::DEPROJECTION: return "deprojection (SIMD)";
+	case EMRStage::UPLOAD: return "texture upload";
+	case EMRStage::PRE_RENDER: return "scene preRender";
+	case EMRStage::RENDER: return "scene render";
+	case EMRStage::IMGUI: return "ImGui";
+	case EMRStage::SWAP: return "buffer swap";
+	case EMRStage::GPU_POINTS: return "GPU point draw";
+	case EMRStage::GPU_SHOW: return "GPU GlTexture::show";
+	case EMRStage::GPU_GIZMO: return "GPU setup gizmo";
+	case EMRStage::GPU_IMGUI: return "GPU ImGui";
+	default: return "?";
+	}
+}
+
+const char* MRStageTimings::thread(EMRStage stage)
+{
+	switch (stage) {
+	case EMRStage::WAIT_FOR_FRAMES: return "capture";
+	case EMRStage::DECIMATION:
+	case EMRStage::POINTCLOUD:
+	case EMRStage::MAP_TO:
+	case EMRStage::DEPROJECTION: return "processing";
+	case EMRStage::GPU_POINTS:
+	case EMRStage::GPU_SHOW:
+	case EMRStage::GPU_GIZMO:
+	case EMRStage::GPU_IMGUI: return "GPU";
+	default: return "render";
+	}
+}
+
+void MRStageTimings::add(EMRStage stage, double millis)
+{
+	Ring& ring = rings[(int)stage];
+	size_t count = ring.count.load(std::memory_order_relaxed);
+	ring.millis[count % RING_SIZE].store((float)millis, std::memory_order_relaxed);
+	ring.count.store(count + 1, std::memory_order_release);
+}
+
+void MRStageTimings::reset()
+{
+	for (Ring& ring : rings)
+		ring.count = 0;
+}
+
+MRStageTimings::Summary MRStageTimings::summary(EMRStage stage) const
+{
+	const Ring& ring = rings[(int)stage];
+	Summary summary;
+	summary.samples = std::min(ring.count.load(std::memory_order_acquire), RING_SIZE);
+	if (summary.samples == 0)
+		return summary;
+
+	// the writer may overwrite the oldest samples meanwhile, which only mixes in newer ones
+	std::vector<float> millis(summary.samples);
+	for (size_t i = 0; i < summary.samples; i++)
+		millis[i] = ring.millis[i].load(std::memory_order_relaxed);
+	std::sort(millis.begin(), millis.end());
+
+	double sum = 0.0;
+	for (float m : millis)
+		sum += m;
+	auto rank = [&](double p) { return millis[std::min((size_t)std::ceil(p * millis.size()), millis.size()) - 1]; };
+	summary.mean = sum / millis.size();
+	summary.p50 = rank(0.50);
+	summary.p95 = rank(0.95);
+	summary.p99 = rank(0.99);
+	summary.max = millis.back();
+	return summary;
+}
+
+bool MRStageTimings::writeCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	file << "stage,thread,samples,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n" << std::fixed << std::setprecision(3);
+	for (int s = 0; s < (int)EMRStage::COUNT; s++) {
+		Summary summary = this->summary((EMRStage)s);
+		file << name((EMRStage)s) << "," << thread((EMRStage)s) << "," << summary.samples << "," << summary.mean << ","
+			<< summary.p50 << "," << summary.p95 << "," << summary.p99 << "," << summary.max << "\n";
+	}
+	return (bool)file;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/////////////////////////////////////////////////////////////////
+// Frame times per stage of the pipeline                       //
+/////////////////////////////////////////////////////////////////
+// Each stage keeps its last RING_SIZE durations (steady_clock, ms) in a ring, percentiles are taken over them.
+// A stage is timed by one thread only (capture, processing or render thread, see MRFramePipeline), while any
+// thread may read the summaries, so the rings need no locks.
+// The GPU_ stages are the time the GPU spent on the commands of the render thread (see GlTimerQueries).
+enum class EMRStage { WAIT_FOR_FRAMES, DECIMATION, POINTCLOUD, MAP_TO, DEPROJECTION, UPLOAD, PRE_RENDER, RENDER, IMGUI, SWAP,
+	GPU_POINTS, GPU_SHOW, GPU_GIZMO, GPU_IMGUI, COUNT };
+
+class MRStageTimings
+{
+public:
+	static const size_t RING_SIZE = 512;	// ~8s at 60 fps
+
+	struct Summary
+	{
+		size_t samples = 0;		// within the ring
+		double mean = 0.0;		// ms
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+private:
+	struct Ring
+	{
+		std::atomic<float> millis[RING_SIZE];
+		std::atomic<size_t> count;	// samples added since the reset, the next one goes to count % RING_SIZE
+	};
+	Ring rings[(int)EMRStage::COUNT];
+
+public:
+	MRStageTimings();
+	MRStageTimings(const MRStageTimings&) = delete;
+	MRStageTimings& operator=(const MRStageTimings&) = delete;
+
+	static const char* name(EMRStage stage);
+	static const char* thread(EMRStage stage);	// thread timing the stage
+
+	void add(EMRStage stage, double millis);
+	void reset();
+
+	// percentiles by nearest rank over the samples in the ring
+	Summary summary(EMRStage stage) const;
+	// one line per stage: stage,thread,samples,mean_ms,p50_ms,p95_ms,p99_ms,max_ms
+	bool writeCsv(const std::string& path) const;
+};
+
+// times its scope (or up to stop()) into the stage, nothing without timings
+class MRStageTimer
+{
+	MRStageTimings* timings;
+	EMRStage stage;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	MRStageTimer(MRStageTimings* timings, EMRStage stage) : timings(timings), stage(stage)
+	{
+		if (timings)
+			start = std::chrono::steady_clock::now();
+	}
+	MRStageTimer(const MRStageTimer&) = delete;
+	MRStageTimer& operator=(const MRStageTimer&) = delete;
+	~MRStageTimer() { stop(); }
+
+	void stop()
+	{
+		if (!timings)
+			return;
+		timings->add(stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		timings = nullptr;
+	}
+};
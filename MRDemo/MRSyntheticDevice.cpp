@@ -0,0 +1,209 @@
+#include "MRSyntheticDevice.h"
+#include "MRProfiler.h"
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// the room before scaling to options.inRange, in m from the camera (y is down)
+static const float WALL_Z = 3.5f;
+static const float FLOOR_Y = 1.2f;			// the camera is 1.2m above the floor
+static const float PERSON_Z = 1.5f;
+static const float PERSON_SWAY = 0.3f;		// m to each side, once in 4s
+static const uint32_t INVALID_PER_256 = 5;	// 2% of the pixels without depth, as at edges and on dark surfaces
+
+MRSyntheticScene::MRSyntheticScene(const MRSyntheticOptions& options) : options(options)
+{
+	const int width = std::min(std::max(options.width, 16), 1280);
+	const int height = std::min(std::max(options.height, 16), 720);
+	this->options.width = width;
+	this->options.height = height;
+	this->options.fps = std::max(options.fps, 1);
+	// D400 depth cameras see ~87 x 58 degrees
+	intrinsics = { width, height, width / 2.f, height / 2.f, 0.53f * width, 0.53f * width, RS2_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+
+	// the zoom puts the boundary between the inRange nearest pixels and the others onto the end of the scan range,
+	// half a depth unit beyond its last depth value, so rounding to depth units does not move pixels across it
+	std::vector<float> valid;
+	valid.reserve((size_t)width * height);
+	const PointRandom random(options.seed, 0);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			bool isPerson;
+			float z = pixelDepth(x, y, 0, random, isPerson);
+			if (z > 0.0f)
+				valid.push_back(z);
+		}
+	}
+	int lastLevel = (int)(options.range.maxZ / depthUnits);		// as compared by the kernels, in float
+	while (lastLevel > 0 && lastLevel * depthUnits > options.range.maxZ)
+		lastLevel--;
+	while ((lastLevel + 1) * depthUnits <= options.range.maxZ)
+		lastLevel++;
+	const float boundary = (lastLevel + 0.5f) * depthUnits;
+	const size_t inRange = (size_t)(std::min(std::max(options.inRange, 0.f), 1.f) * width * height + 0.5f);
+	if (valid.empty())
+		zoom = 1.0f;
+	else if (inRange == 0)
+		zoom = 1.01f * boundary / *std::min_element(valid.begin(), valid.end());
+	else if (inRange >= valid.size())
+		zoom = 0.99f * options.range.maxZ / *std::max_element(valid.begin(), valid.end());
+	else {
+		std::nth_element(valid.begin(), valid.begin() + inRange, valid.end());
+		float last = *std::max_element(valid.begin(), valid.begin() + inRange);	// farthest pixel within the range
+		float first = valid[inRange];												// nearest pixel beyond
+		zoom = boundary / ((last + first) / 2.f);
+	}
+}
+
+float MRSyntheticScene::pixelDepth(int x, int y, uint32_t frameNumber, const PointRandom& random, bool& isPerson) const
+{
+	float z = sceneDepth(x, y, frameNumber, isPerson);
+	const uint32_t bits = random.bits((size_t)y * options.width + x);
+	if (z > 0.0f) {
+		z += options.noise * ((bits >> 8) * (2.0f / 16777216.0f) - 1.0f);
+		if ((bits & 0xFF) < INVALID_PER_256)
+			z = 0.0f;
+	}
+	return z;
+}
+
+float MRSyntheticScene::sceneDepth(int x, int y, uint32_t frameNumber, bool& isPerson) const
+{
+	const float xn = (x - intrinsics.ppx) / intrinsics.fx;
+	const float yn = (y - intrinsics.ppy) / intrinsics.fy;
+	float z = 0.0f;
+	if (options.planes) {
+		z = WALL_Z;
+		if (yn > 0.0f)
+			z = std::min(z, FLOOR_Y / yn);
+	}
+
+	isPerson = false;
+	if (options.person) {
+		// body and head as ellipses in the plane at PERSON_Z, bulging towards the camera
+		const float sway = PERSON_SWAY * std::sin(frameNumber * 6.2831853f / (4.0f * options.fps));
+		const float px = xn * PERSON_Z - sway;
+		const float py = yn * PERSON_Z;
+		const float body = (px / 0.25f) * (px / 0.25f) + ((py - 0.3f) / 0.8f) * ((py - 0.3f) / 0.8f);
+		const float head = (px * px + (py + 0.62f) * (py + 0.62f)) / (0.11f * 0.11f);
+		const float r2 = std::min(body, head);
+		if (r2 < 1.0f) {
+			z = PERSON_Z - 0.15f * std::sqrt(1.0f - r2);
+			isPerson = true;
+		}
+	}
+	return z;
+}
+
+void MRSyntheticScene::render(uint32_t frameNumber, uint16_t* depth, uint8_t* rgb) const
+{
+	const int width = options.width;
+	const int height = options.height;
+	const PointRandom random(options.seed, frameNumber);
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const int i = y * width + x;
+			bool isPerson;
+			float z = pixelDepth(x, y, frameNumber, random, isPerson);
+			depth[i] = (uint16_t)std::min(std::max(z * zoom / depthUnits + 0.5f, 0.0f), 65535.0f);
+
+			uint8_t* c = rgb + 3 * i;
+			if (isPerson) {
+				c[0] = 200; c[1] = 60; c[2] = 40;
+			}
+			else {
+				c[0] = (uint8_t)(255 * x / width);
+				c[1] = (uint8_t)(255 * y / height);
+				c[2] = ((x / 16 + y / 16) & 1) ? 255 : 0;
+			}
+		}
+	}
+}
+
+
+MRSyntheticDevice::MRSyntheticDevice(const MRSyntheticOptions& options) : scene(options)
+, depthSensor(device.add_sensor("Depth"))
+, colorSensor(device.add_sensor("Color"))
+, running(false)
+{
+	const rs2_intrinsics& in = scene.getIntrinsics();
+	const int fps = scene.getOptions().fps;
+	depthProfile = depthSensor.add_video_stream({ RS2_STREAM_DEPTH, 0, 0, in.width, in.height, fps, 2, RS2_FORMAT_Z16, in });
+	depthSensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, scene.getDepthUnits());
+	colorProfile = colorSensor.add_video_stream({ RS2_STREAM_COLOR, 0, 1, in.width, in.height, fps, 3, RS2_FORMAT_RGB8, in });
+	depthProfile.register_extrinsics_to(colorProfile, { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0 } });
+	device.create_matcher(RS2_MATCHER_DLR_C);	// depth and color by frame number
+}
+
+MRSyntheticDevice::~MRSyntheticDevice()
+{
+	stop();
+}
+
+void MRSyntheticDevice::start(rs2::syncer& syncer)
+{
+	depthSensor.open(depthProfile);
+	colorSensor.open(colorProfile);
+	depthSensor.start(syncer);
+	colorSensor.start(syncer);
+	running = true;
+	generator = std::thread(&MRSyntheticDevice::generateLoop, this);
+	const MRSyntheticOptions& options = scene.getOptions();
+	std::cout << "synthetic frames " << options.width << "x" << options.height << " at " << options.fps << " fps, "
+		<< (int)(100 * options.inRange) << "% within the scan range" << std::endl;
+}
+
+void MRSyntheticDevice::stop()
+{
+	if (!running)
+		return;
+	running = false;
+	if (generator.joinable())
+		generator.join();
+	depthSensor.stop();
+	colorSensor.stop();
+	depthSensor.close();
+	colorSensor.close();
+}
+
+void MRSyntheticDevice::generateLoop()
+{
+	MR_PROFILE_THREAD("synthetic");
+	const rs2_intrinsics& in = scene.getIntrinsics();
+	const int fps = scene.getOptions().fps;
+	const auto period = std::chrono::microseconds(1000000 / fps);
+	auto next = std::chrono::steady_clock::now();
+	for (uint32_t frameNumber = 1; running; frameNumber++)
+	{
+		// the sensors take the pixels over and release them with the frames
+		uint16_t* depth = new uint16_t[in.width * in.height];
+		uint8_t* rgb = new uint8_t[3 * in.width * in.height];
+		{
+			MR_PROFILE_ZONE("MRSyntheticScene::render");
+			scene.render(frameNumber, depth, rgb);
+		}
+		const rs2_time_t timestamp = frameNumber * 1000.0 / fps;	// ms
+		try {
+			depthSensor.on_video_frame({ depth, [](void* p) { delete[] static_cast<uint16_t*>(p); }, 2 * in.width, 2,
+				timestamp, RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, (int)frameNumber, depthProfile.get() });
+			colorSensor.on_video_frame({ rgb, [](void* p) { delete[] static_cast<uint8_t*>(p); }, 3 * in.width, 3,
+				timestamp, RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, (int)frameNumber, colorProfile.get() });
+		}
+		catch (const rs2::error& e) {
+			std::cerr << "synthetic: " << e.what() << std::endl;
+		}
+
+		next += period;
+		auto now = std::chrono::steady_clock::now();
+		if (next > now)
+			std::this_thread::sleep_until(next);
+		else
+			next = now;		// behind, e.g. at high resolutions on few cores: no burst to catch up
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <librealsense2/rs.hpp> // Include RealSense Cross Platform API
+#include <librealsense2/hpp/rs_internal.hpp>
+
+#include "MRKernels.h"
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+
+/////////////////////////////////////////////////////////////////
+// Procedural depth and color frames                           //
+/////////////////////////////////////////////////////////////////
+// A room as seen by the camera: floor and back wall, a person in front of them swaying from side to side,
+// noise on the depth and some pixels without depth. The depths are scaled so that the given fraction
+// of all pixels lies within the scan range, so the load of the scenes can be set independently of the resolution.
+struct MRSyntheticOptions
+{
+	int width = 848;			// of depth and color, up to 1280x720
+	int height = 480;
+	int fps = 30;
+	bool person = true;			// person-sized blob, 1.5m from the camera before scaling
+	bool planes = true;			// floor and back wall, otherwise the background has no depth
+	float noise = 0.005f;		// m, amplitude of the depth noise
+	float inRange = 0.3f;		// fraction of the pixels within the scan range
+	ScanRange range{ 0.0f, 1.0f };
+	uint32_t seed = 4711;
+};
+
+class MRSyntheticScene
+{
+	MRSyntheticOptions options;
+	rs2_intrinsics intrinsics;
+	float depthUnits = 0.001f;	// m per depth unit
+	float zoom = 1.0f;			// scales the depths to reach options.inRange
+
+public:
+	explicit MRSyntheticScene(const MRSyntheticOptions& options);
+
+	const MRSyntheticOptions& getOptions() const { return options; }
+	const rs2_intrinsics& getIntrinsics() const { return intrinsics; }	// the same for depth and color
+	float getDepthUnits() const { return depthUnits; }
+
+	// depth (Z16, width * height) and color (RGB8, 3 * width * height) of the frame, the same for the same frame number
+	void render(uint32_t frameNumber, uint16_t* depth, uint8_t* rgb) const;
+
+private:
+	float sceneDepth(int x, int y, uint32_t frameNumber, bool& isPerson) const;	// m, 0..no depth
+	float pixelDepth(int x, int y, uint32_t frameNumber, const PointRandom& random, bool& isPerson) const;	// with noise
+};
+
+
+/////////////////////////////////////////////////////////////////
+// The frames as a RealSense device                            //
+/////////////////////////////////////////////////////////////////
+// rs2::software_device with a depth and a color sensor, fed by a thread at the frame rate of the options.
+// The frames carry the same frame number and timestamp, a syncer combines them into framesets like rs2::pipeline.
+class MRSyntheticDevice
+{
+	MRSyntheticScene scene;
+	rs2::software_device device;
+	rs2::software_sensor depthSensor;
+	rs2::software_sensor colorSensor;
+	rs2::stream_profile depthProfile;
+	rs2::stream_profile colorProfile;
+
+	std::thread generator;
+	std::atomic<bool> running;
+
+public:
+	explicit MRSyntheticDevice(const MRSyntheticOptions& options);
+	MRSyntheticDevice(const MRSyntheticDevice&) = delete;
+	MRSyntheticDevice& operator=(const MRSyntheticDevice&) = delete;
+	~MRSyntheticDevice();
+
+	const MRSyntheticScene& getScene() const { return scene; }
+
+	// starts both sensors into the syncer and the thread generating the frames
+	void start(rs2::syncer& syncer);
+	void stop();
+
+private:
+	void generateLoop();
+};
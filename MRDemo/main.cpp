@@ -7,23 +7,131 @@
 
 #include <string>
 #include <iostream>
-#include <ctime>
+#include <algorithm>			// std::max
+#include <cstdlib>				// std::strtol(), std::strtof()
 
 #include "MRDemo.h"
 
 
+// MRDemo [--playback recording.bag [--fast] [--loops n]]
+// MRDemo --synthetic WxH [--fps n] [--in-range percent] [--noise mm] [--no-person] [--no-planes]
+//   --playback  replays the recording instead of the camera (which then needs not be attached)
+//   --fast      processes the recorded frames as fast as possible, none is dropped (not in real time)
+//   --loops n   exits after n passes through the recording and reports the throughput, default endless
+//   --synthetic generates the frames (see MRSyntheticDevice), up to 1280x720, with the given share of pixels
+//               within the scan range
+// any of them with [--headless [--dump n] [--dump-dir directory]] [--frames n]
+//   --headless  renders offscreen into a framebuffer object, the window stays hidden
+//   --dump n    saves every nth frame of the headless window as PPM, into ./frames by default
+//   --frames n  exits after n frames and reports the frame rate
+// and with [--timings file.csv], the percentiles of the durations per stage written at exit (also key P),
+// [--trace file.json], the zones of the last seconds of all threads for chrome://tracing written at exit (also key Z),
+// [--latency file.csv], the histogram of the capture-to-display latency written at exit (also key L)
+// and [--rs-queue n], the frames librealsense holds per stream before it drops frames
+static bool parseOptions(int argc, char * argv[], MRDemoOptions& options)
+{
+	MRSyntheticOptions& synthetic = options.syntheticOptions;
+	// options of one input or of the headless window, only valid with it
+	bool playbackOption = false, syntheticOption = false, dumpOption = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if ((arg == "--playback" || arg == "-p") && hasValue)
+			options.playbackFile = argv[++i];
+		else if (arg == "--fast") {
+			options.realTime = false;
+			playbackOption = true;
+		}
+		else if (arg == "--loops" && hasValue) {
+			options.loops = std::max(0, (int)std::strtol(argv[++i], nullptr, 10));
+			playbackOption = true;
+		}
+		else if (arg == "--synthetic" && hasValue) {
+			char* end = nullptr;
+			synthetic.width = (int)std::strtol(argv[++i], &end, 10);
+			if (*end != 'x')
+				return false;
+			synthetic.height = (int)std::strtol(end + 1, nullptr, 10);
+			options.synthetic = true;
+		}
+		else if (arg == "--fps" && hasValue) {
+			synthetic.fps = (int)std::strtol(argv[++i], nullptr, 10);
+			syntheticOption = true;
+		}
+		else if (arg == "--in-range" && hasValue) {
+			synthetic.inRange = std::strtof(argv[++i], nullptr) / 100.f;
+			syntheticOption = true;
+		}
+		else if (arg == "--noise" && hasValue) {
+			synthetic.noise = std::strtof(argv[++i], nullptr) / 1000.f;
+			syntheticOption = true;
+		}
+		else if (arg == "--no-person") {
+			synthetic.person = false;
+			syntheticOption = true;
+		}
+		else if (arg == "--no-planes") {
+			synthetic.planes = false;
+			syntheticOption = true;
+		}
+		else if (arg == "--headless")
+			options.headless = true;
+		else if (arg == "--dump" && hasValue) {
+			options.dumpEvery = std::max(0, (int)std::strtol(argv[++i], nullptr, 10));
+			dumpOption = true;
+		}
+		else if (arg == "--dump-dir" && hasValue) {
+			options.dumpDirectory = argv[++i];
+			dumpOption = true;
+		}
+		else if (arg == "--frames" && hasValue)
+			options.frames = std::max(0, (int)std::strtol(argv[++i], nullptr, 10));
+		else if (arg == "--timings" && hasValue)
+			options.timingsFile = argv[++i];
+		else if (arg == "--trace" && hasValue)
+			options.traceFile = argv[++i];
+		else if (arg == "--latency" && hasValue)
+			options.latencyFile = argv[++i];
+		else if (arg == "--rs-queue" && hasValue)
+			options.frameQueueSize = std::max(0, (int)std::strtol(argv[++i], nullptr, 10));
+		else
+			return false;
+	}
+	if (playbackOption && options.playbackFile.empty())
+		return false;	// --fast and --loops need a recording, they would be ignored
+	if (syntheticOption && !options.synthetic)
+		return false;
+	if (dumpOption && !options.headless)
+		return false;	// only the headless window dumps its frames
+	return !(options.synthetic && options.playbackFile.size());
+}
+
 int main(int argc, char * argv[]) try
 {
-	std::srand((unsigned int)std::time(nullptr)); // use current time as seed for random generator
+	MRDemoOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cerr << "usage: MRDemo [--playback recording.bag [--fast] [--loops n]]\n"
+			<< "       MRDemo --synthetic WxH [--fps n] [--in-range percent] [--noise mm] [--no-person] [--no-planes]\n"
+			<< "       any of them with [--headless [--dump n] [--dump-dir directory]] [--frames n] [--timings file.csv] [--trace file.json]\n"
+			<< "       [--latency file.csv] [--rs-queue n]" << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	// Create a simple OpenGL window for rendering:
 	// Construct an object to manage view state
-	MRDemo app;
-	while (app) // Application still alive?
+	MRDemo app(options);
+	while (app && !app.isFinished()) // Application still alive?
 	{
 		if (!app.run())
 			return EXIT_FAILURE;
 	}
+	if (options.timingsFile.size())
+		app.writeTimings(options.timingsFile);
+	if (options.traceFile.size())
+		app.writeTrace(options.traceFile);
+	if (options.latencyFile.size())
+		app.writeLatency(options.latencyFile);
 
 	return EXIT_SUCCESS;
 }